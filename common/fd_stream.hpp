@@ -0,0 +1,439 @@
+// Runs Intcode computers as stream filters over non-blocking file descriptors.
+// Any number of computers share one epoll loop, each reading words from an
+// input fd and writing its outputs to an output fd, so they can be chained
+// through pipes or served over sockets without the host copying values.
+//
+// A computer needs run_for(budget), hcf and blocked flags, an input queue and
+// an output queue, which the day 7 and day 9 computers all have.
+//
+// Signal handling is left to the program. Sockets are written without
+// raising SIGPIPE, but a pipe whose reader has gone raises it unless the
+// program ignores it, in which case the stream finishes as Broken.
+
+#include <vector>
+#include <queue>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+enum class Framing
+{
+    Text,  // Decimal words separated by whitespace or commas, one per line out
+    Binary // Host order int64_t words
+};
+
+enum class StreamStatus
+{
+    Running,
+    Halted,  // Program halted and its output was flushed
+    Starved, // Program wanted input after its input fd hit end of file
+    Broken,  // Output fd was closed or failed
+    BadInput // Program wanted input past a token that isn't a word
+};
+
+template<typename T>
+void enqueue(std::queue<T> &queue, T data)
+{
+    queue.push(data);
+}
+
+template<typename T>
+void enqueue(std::deque<T> &queue, T data)
+{
+    queue.push_back(data);
+}
+
+template<typename Computer>
+class StreamLoop
+{
+public:
+    using Word = std::decay_t<decltype(std::declval<Computer>().output.front())>;
+
+    StreamLoop()
+    {
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0)
+        {
+            throw std::runtime_error("epoll_create1 failed");
+        }
+    };
+
+    // Fds left open go back to blocking, as they may be shared with a shell
+    ~StreamLoop()
+    {
+        for (const auto &[fd, flags] : original_flags)
+        {
+            fcntl(fd, F_SETFL, flags);
+        }
+        close(epoll);
+    };
+
+    StreamLoop(const StreamLoop &) = delete;
+    StreamLoop &operator=(const StreamLoop &) = delete;
+
+    // Feed computer from in and send its outputs to out. The output fd is
+    // closed once the stream finishes so whatever reads it sees end of file,
+    // unless close_output is false. Input fds are left for the caller.
+    // Returns the stream's index for status().
+    size_t attach(Computer &computer, int in, int out, Framing framing, bool close_output = true)
+    {
+        Stream &stream = streams.emplace_back();
+        stream.computer = &computer;
+        stream.in = in;
+        stream.out = out;
+        stream.framing = framing;
+        stream.close_output = close_output;
+
+        struct stat info;
+        stream.socket = fstat(out, &info) == 0 && S_ISSOCK(info.st_mode);
+
+        size_t index = streams.size() - 1;
+        watch(in, index);
+        if (out != in)
+        {
+            watch(out, index);
+        }
+        runnable.push_back(index);
+        return index;
+    };
+
+    // Run until every stream has finished
+    void run()
+    {
+        std::vector<epoll_event> events(64);
+        while (finished < streams.size())
+        {
+            std::vector<size_t> ready;
+            ready.swap(runnable);
+            for (size_t index : ready)
+            {
+                service(index);
+            }
+
+            if (finished == streams.size())
+            {
+                break;
+            }
+
+            // Only sleep when nothing can make progress without an fd
+            int n = epoll_wait(epoll, events.data(), events.size(), runnable.empty() ? -1 : 0);
+            if (n < 0 && errno != EINTR)
+            {
+                throw std::runtime_error("epoll_wait failed");
+            }
+            for (int i = 0; i < n; i++)
+            {
+                wake(events[i].data.fd);
+            }
+        }
+    };
+
+    StreamStatus status(size_t index) const
+    {
+        return streams[index].status;
+    };
+
+    // Instructions per turn, so one busy computer can't starve the others
+    static const unsigned long kSlice{1 << 16};
+    // Stop running a computer while this much output waits on its fd
+    static const size_t kHighWater{1 << 16};
+    // Longest text word, an int64_t is at most a sign and 19 digits
+    static const size_t kMaxWordText{20};
+
+private:
+    struct Stream
+    {
+        Computer *computer;
+        int in;
+        int out;
+        Framing framing;
+        bool close_output;
+        bool socket;              // Output can be sent with MSG_NOSIGNAL
+        StreamStatus status{StreamStatus::Running};
+        bool parked{false};       // Waiting on an fd event
+        bool eof{false};          // Input fd hit end of file
+        bool malformed{false};    // Decoding stopped at a bad token
+        std::string read_buffer;  // Bytes read but not yet decoded
+        std::string write_buffer; // Encoded outputs not yet written
+        size_t written{0};        // Bytes of write_buffer already written
+    };
+
+    void watch(int fd, size_t index)
+    {
+        watchers[fd].push_back(index);
+
+        int flags = fcntl(fd, F_GETFL);
+        original_flags.emplace(fd, flags);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        // Edge triggered, streams always read or write until EAGAIN before
+        // parking. Regular files can't be polled but never block either.
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0 && errno != EEXIST && errno != EPERM)
+        {
+            throw std::runtime_error("epoll_ctl failed");
+        }
+    };
+
+    void wake(int fd)
+    {
+        for (size_t index : watchers[fd])
+        {
+            Stream &stream = streams[index];
+            if (stream.parked)
+            {
+                stream.parked = false;
+                runnable.push_back(index);
+            }
+        }
+    };
+
+    // Give one stream a turn: flush, decode input, run a slice, then either
+    // queue it again or park it until one of its fds is ready
+    void service(size_t index)
+    {
+        Stream &stream = streams[index];
+        Computer &computer = *stream.computer;
+
+        if (!flush(stream))
+        {
+            return finish(stream, StreamStatus::Broken);
+        }
+        if (pending(stream) >= kHighWater)
+        {
+            stream.parked = true;
+            return;
+        }
+
+        // run_for stops at every output, so keep going until the slice is
+        // spent and write everything it produced at once
+        decode(stream);
+        const unsigned long slice_end = computer.retired + kSlice;
+        do
+        {
+            computer.run_for(slice_end - computer.retired);
+            while (!computer.output.empty())
+            {
+                encode(stream, computer.output.front());
+                computer.output.pop();
+            }
+        } while (!computer.hcf && !computer.blocked && computer.retired < slice_end && pending(stream) < kHighWater);
+
+        if (!flush(stream))
+        {
+            return finish(stream, StreamStatus::Broken);
+        }
+
+        if (computer.hcf)
+        {
+            if (pending(stream))
+            {
+                // Come back once the last of the output can be written
+                stream.parked = true;
+                return;
+            }
+            return finish(stream, StreamStatus::Halted);
+        }
+
+        if (computer.blocked)
+        {
+            if (!stream.eof && !stream.malformed)
+            {
+                fill(stream);
+            }
+            if (decode(stream))
+            {
+                runnable.push_back(index);
+                return;
+            }
+            if (stream.malformed && !pending(stream))
+            {
+                return finish(stream, StreamStatus::BadInput);
+            }
+            if (stream.eof && !pending(stream))
+            {
+                return finish(stream, StreamStatus::Starved);
+            }
+            stream.parked = true;
+            return;
+        }
+
+        runnable.push_back(index);
+    };
+
+    // Read until the fd runs dry or the buffer is full
+    void fill(Stream &stream)
+    {
+        char chunk[1 << 16];
+        while (stream.read_buffer.size() < kHighWater)
+        {
+            ssize_t n = read(stream.in, chunk, sizeof(chunk));
+            if (n > 0)
+            {
+                stream.read_buffer.append(chunk, n);
+            }
+            else if (n == 0)
+            {
+                stream.eof = true;
+                return;
+            }
+            else if (errno != EINTR)
+            {
+                // EAGAIN, or an error which ends the input just the same
+                stream.eof = (errno != EAGAIN && errno != EWOULDBLOCK);
+                return;
+            }
+        }
+    };
+
+    // Move every complete word in the read buffer onto the computer's input.
+    // A text token that isn't a word, or doesn't fit in one, is left at the
+    // front of the buffer and nothing after it is decoded.
+    size_t decode(Stream &stream)
+    {
+        size_t words{0};
+        size_t pos{0};
+        std::string &buffer = stream.read_buffer;
+
+        if (stream.malformed)
+        {
+            return 0;
+        }
+
+        if (stream.framing == Framing::Binary)
+        {
+            for (; pos + sizeof(int64_t) <= buffer.size(); pos += sizeof(int64_t))
+            {
+                int64_t data;
+                std::memcpy(&data, buffer.data() + pos, sizeof(data));
+                enqueue(stream.computer->input, static_cast<Word>(data));
+                words++;
+            }
+        }
+        else
+        {
+            while (true)
+            {
+                pos = buffer.find_first_not_of(" \t\r\n,", pos);
+                if (pos == std::string::npos)
+                {
+                    pos = buffer.size();
+                    break;
+                }
+
+                // A word at the end of the buffer may be cut short, unless
+                // the input is over. One already too long to be a word is
+                // bad however it ends, and waiting for the rest could fill
+                // the buffer before end of file is ever seen.
+                size_t end = buffer.find_first_of(" \t\r\n,", pos);
+                if (end == std::string::npos && !stream.eof)
+                {
+                    stream.malformed = (buffer.size() - pos > kMaxWordText);
+                    break;
+                }
+                end = (end == std::string::npos) ? buffer.size() : end;
+
+                Word data{0};
+                auto [ptr, ec] = std::from_chars(buffer.data() + pos, buffer.data() + end, data);
+                if (ec != std::errc() || ptr != buffer.data() + end)
+                {
+                    stream.malformed = true;
+                    break;
+                }
+                enqueue(stream.computer->input, data);
+                words++;
+                pos = end;
+            }
+        }
+
+        buffer.erase(0, pos);
+        return words;
+    };
+
+    void encode(Stream &stream, Word data)
+    {
+        if (stream.framing == Framing::Binary)
+        {
+            int64_t word = data;
+            stream.write_buffer.append(reinterpret_cast<const char *>(&word), sizeof(word));
+        }
+        else
+        {
+            char text[24];
+            char *end = std::to_chars(text, text + sizeof(text), data).ptr;
+            *end++ = '\n';
+            stream.write_buffer.append(text, end);
+        }
+    };
+
+    size_t pending(const Stream &stream) const
+    {
+        return stream.write_buffer.size() - stream.written;
+    };
+
+    // Write as much buffered output as the fd takes, false if it's broken
+    bool flush(Stream &stream)
+    {
+        while (pending(stream))
+        {
+            const char *data = stream.write_buffer.data() + stream.written;
+            ssize_t n = stream.socket ? send(stream.out, data, pending(stream), MSG_NOSIGNAL)
+                                      : write(stream.out, data, pending(stream));
+            if (n > 0)
+            {
+                stream.written += n;
+            }
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            else if (n < 0 && errno != EINTR)
+            {
+                return false;
+            }
+        }
+
+        if (stream.written == stream.write_buffer.size())
+        {
+            stream.write_buffer.clear();
+            stream.written = 0;
+        }
+
+        return true;
+    };
+
+    void finish(Stream &stream, StreamStatus status)
+    {
+        stream.status = status;
+        stream.parked = false;
+        finished++;
+
+        if (stream.close_output)
+        {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, stream.out, nullptr);
+            watchers.erase(stream.out);
+            original_flags.erase(stream.out);
+            close(stream.out);
+        }
+    };
+
+    int epoll;
+    std::deque<Stream> streams;
+    std::vector<size_t> runnable;
+    std::unordered_map<int, std::vector<size_t>> watchers; // Streams using each fd
+    std::unordered_map<int, int> original_flags;
+    size_t finished{0};
+};
@@ -0,0 +1,131 @@
+// Splitting puzzle input without copying it. Fields are std::string_view
+// slices of the original text, produced one at a time as a loop asks for
+// them, so nothing is allocated and the text is read once. The text has to
+// outlive the fields.
+
+#include <string_view>
+#include <utility>
+#include <iterator>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+
+class Tokens
+{
+public:
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::string_view value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::string_view *pointer;
+        typedef std::string_view reference;
+
+        iterator() = default;
+
+        iterator(const char *start, const char *end, char delimiter)
+            : start(start), end(end), delimiter(delimiter)
+        {
+            find();
+        };
+
+        std::string_view operator*() const
+        {
+            return std::string_view(start, field_end - start);
+        };
+
+        // Past the last field start goes null, which is where end() is
+        iterator &operator++()
+        {
+            if (field_end == end)
+            {
+                start = nullptr;
+            }
+            else
+            {
+                start = field_end + 1;
+                find();
+            }
+            return *this;
+        };
+
+        iterator operator++(int)
+        {
+            iterator previous = *this;
+            ++*this;
+            return previous;
+        };
+
+        bool operator==(const iterator &other) const
+        {
+            return start == other.start;
+        };
+
+        bool operator!=(const iterator &other) const
+        {
+            return start != other.start;
+        };
+
+    private:
+        // memchr is vectorized by the C library, so long fields are scanned
+        // many bytes at a time
+        void find()
+        {
+            const void *found = std::memchr(start, delimiter, end - start);
+            field_end = found ? static_cast<const char *>(found) : end;
+        };
+
+        const char *start{nullptr};
+        const char *field_end{nullptr};
+        const char *end{nullptr};
+        char delimiter{','};
+    };
+
+    Tokens(std::string_view text, char delimiter)
+        : text(text), delimiter(delimiter)
+    {
+    };
+
+    // n delimiters always make n + 1 fields, even when some are empty
+    iterator begin() const
+    {
+        const char *start = text.data() ? text.data() : "";
+        return iterator(start, start + text.size(), delimiter);
+    };
+
+    iterator end() const
+    {
+        return iterator();
+    };
+
+private:
+    std::string_view text;
+    char delimiter;
+};
+
+inline Tokens tokenize(std::string_view text, char delimiter = ',')
+{
+    return Tokens(text, delimiter);
+}
+
+// The text before and after the first delimiter, or all of it and nothing
+// if there isn't one
+inline std::pair<std::string_view, std::string_view> split_once(std::string_view text, char delimiter)
+{
+    const size_t at = text.find(delimiter);
+    if (at == std::string_view::npos)
+    {
+        return {text, std::string_view()};
+    }
+    return {text.substr(0, at), text.substr(at + 1)};
+}
+
+// The number at the start of text, or fallback if it doesn't start with one
+template<typename T = int>
+inline T parse_int(std::string_view text, T fallback = 0)
+{
+    T value = fallback;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
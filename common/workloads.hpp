@@ -0,0 +1,345 @@
+// Parameterized Intcode programs for benchmarking the computers. Every
+// generator knows the sum of its outputs and how many instructions a full run
+// retires, so a benchmark can check its answer and report a rate.
+//
+// Programs keep their data after the code and only use opcodes 1-8 and
+// position or immediate modes, unless noted, so day 5 and day 7 can run them.
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+
+template<typename Word>
+struct Workload
+{
+    std::string name;
+    long size;                  // The parameter the program was generated with
+    std::vector<Word> program;
+    std::vector<Word> input;    // Values to feed, one per In
+    int64_t expected;           // Sum of every output
+    unsigned long instructions; // Retired by a full run, including the halt
+};
+
+// Emits instructions and lays out variables after the code once it's done
+template<typename Word>
+class Assembler
+{
+public:
+    enum Kind
+    {
+        Position,
+        Immediate,
+        Relative,
+        Variable, // Position of a variable
+        End       // Immediate address of the first word after the program
+    };
+
+    struct Operand
+    {
+        Word value;
+        Kind kind;
+    };
+
+    static Operand pos(Word addr) { return {addr, Position}; }
+    static Operand imm(Word value) { return {value, Immediate}; }
+    static Operand rel(Word offset) { return {offset, Relative}; }
+    static Operand end(Word offset = 0) { return {offset, End}; }
+
+    Operand variable(Word initial)
+    {
+        data.push_back(initial);
+        return {static_cast<Word>(data.size() - 1), Variable};
+    };
+
+    // Address the next instruction will be at
+    Word here() const
+    {
+        return code.size();
+    };
+
+    // Returns the address of the instruction so its operands can be patched
+    Word emit(int opcode, std::vector<Operand> operands = {})
+    {
+        Word at = here();
+        Word word = opcode;
+        int scale = 100;
+        for (const Operand &operand : operands)
+        {
+            int mode = (operand.kind == Immediate || operand.kind == End) ? 1 : (operand.kind == Relative) ? 2 : 0;
+            word += mode * scale;
+            scale *= 10;
+        }
+
+        code.push_back(word);
+        for (const Operand &operand : operands)
+        {
+            if (operand.kind == Variable || operand.kind == End)
+            {
+                fixups.push_back({static_cast<Word>(code.size()), operand});
+            }
+            code.push_back(operand.value);
+        }
+
+        return at;
+    };
+
+    void patch(Word addr, Word value)
+    {
+        code[addr] = value;
+    };
+
+    std::vector<Word> finish()
+    {
+        Word data_start = code.size();
+        Word program_end = data_start + data.size();
+        for (const auto &[addr, operand] : fixups)
+        {
+            code[addr] = operand.value + ((operand.kind == Variable) ? data_start : program_end);
+        }
+
+        std::vector<Word> program = code;
+        program.insert(program.end(), data.begin(), data.end());
+        return program;
+    };
+
+private:
+    std::vector<Word> code;
+    std::vector<Word> data;
+    std::vector<std::pair<Word, Operand>> fixups;
+};
+
+enum WorkloadOp
+{
+    OpAdd = 1,
+    OpMul = 2,
+    OpIn = 3,
+    OpOut = 4,
+    OpJit = 5,
+    OpJif = 6,
+    OpEq = 8,
+    OpRbo = 9,
+    OpHcf = 99
+};
+
+// n adds in a row with no loop, for day 2 which only has Add, Mul and Hcf.
+// Leaves n in address 0 instead of outputting it.
+template<typename Word>
+Workload<Word> straight_line(long n)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto acc = a.variable(0);
+    auto one = a.variable(1);
+    auto zero = a.variable(0);
+
+    for (long i = 0; i < n; i++)
+    {
+        a.emit(OpAdd, {acc, one, acc});
+    }
+    a.emit(OpAdd, {acc, zero, A::pos(0)});
+    a.emit(OpHcf);
+
+    return {"straight line", n, a.finish(), {}, n, static_cast<unsigned long>(n) + 2};
+}
+
+// A tight counted loop of adds and multiplies
+template<typename Word>
+Workload<Word> arithmetic_loop(long n)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto acc = a.variable(0);
+    auto i = a.variable(n);
+    auto scratch = a.variable(0);
+
+    Word top = a.here();
+    a.emit(OpAdd, {acc, A::imm(3), acc});
+    a.emit(OpMul, {i, A::imm(2), scratch});
+    a.emit(OpAdd, {i, A::imm(-1), i});
+    a.emit(OpJit, {i, A::imm(top)});
+    a.emit(OpOut, {acc});
+    a.emit(OpHcf);
+
+    return {"arithmetic loop", n, a.finish(), {}, 3 * int64_t(n), 4 * static_cast<unsigned long>(n) + 2};
+}
+
+// Recursion depth deep, repeated, with frames on a relative base stack past
+// the end of the program. Needs the day 9 relative base, and 3 words of ram
+// per level.
+template<typename Word>
+Workload<Word> recursion(long depth, long repeats)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto acc = a.variable(0);
+    auto r = a.variable(repeats);
+
+    // Frames are [return address, n, result]
+    a.emit(OpRbo, {A::end()});
+    Word outer = a.here();
+    a.emit(OpAdd, {A::imm(depth), A::imm(0), A::rel(1)});
+    Word set_return = a.emit(OpAdd, {A::imm(0), A::imm(0), A::rel(0)});
+    Word call = a.emit(OpJit, {A::imm(1), A::imm(0)});
+    a.patch(set_return + 1, a.here());
+    a.emit(OpAdd, {acc, A::rel(2), acc});
+    a.emit(OpAdd, {r, A::imm(-1), r});
+    a.emit(OpJit, {r, A::imm(outer)});
+    a.emit(OpOut, {acc});
+    a.emit(OpHcf);
+
+    // f(n) = n ? f(n - 1) + 1 : 0
+    Word f = a.here();
+    a.patch(call + 2, f);
+    Word test = a.emit(OpJif, {A::rel(1), A::imm(0)});
+    a.emit(OpAdd, {A::rel(1), A::imm(-1), A::rel(4)});
+    Word push = a.emit(OpAdd, {A::imm(0), A::imm(0), A::rel(3)});
+    a.emit(OpRbo, {A::imm(3)});
+    a.emit(OpJit, {A::imm(1), A::imm(f)});
+    a.patch(push + 1, a.here());
+    a.emit(OpRbo, {A::imm(-3)});
+    a.emit(OpAdd, {A::rel(5), A::imm(1), A::rel(2)});
+    a.emit(OpJit, {A::imm(1), A::rel(0)});
+    a.patch(test + 2, a.here());
+    a.emit(OpAdd, {A::imm(0), A::imm(0), A::rel(2)});
+    a.emit(OpJit, {A::imm(1), A::rel(0)});
+
+    unsigned long instructions = repeats * (8 * static_cast<unsigned long>(depth) + 9) + 3;
+    return {"recursion", depth, a.finish(), {}, int64_t(depth) * repeats, instructions};
+}
+
+// A loop that flips one of its own instructions between Add and Mul every
+// iteration, so the add only counts on odd iterations
+template<typename Word>
+Workload<Word> self_modifying(long n)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto acc = a.variable(0);
+    auto i = a.variable(n);
+
+    Word top = a.here();
+    a.emit(OpAdd, {acc, A::imm(1), acc});
+
+    // 1001 <-> 1002
+    a.emit(OpMul, {A::pos(top), A::imm(-1), A::pos(top)});
+    a.emit(OpAdd, {A::pos(top), A::imm(2003), A::pos(top)});
+    a.emit(OpAdd, {i, A::imm(-1), i});
+    a.emit(OpJit, {i, A::imm(top)});
+    a.emit(OpOut, {acc});
+    a.emit(OpHcf);
+
+    return {"self-modifying", n, a.finish(), {}, (int64_t(n) + 1) / 2, 5 * static_cast<unsigned long>(n) + 2};
+}
+
+// Read a value and write it straight back, n times. Every value is the same
+// single digit so day 5, which repeats its one input and concatenates its
+// outputs, can check the run by summing digits.
+template<typename Word>
+Workload<Word> echo(long n)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto value = a.variable(0);
+    auto i = a.variable(n);
+
+    Word top = a.here();
+    a.emit(OpIn, {value});
+    a.emit(OpOut, {value});
+    a.emit(OpAdd, {i, A::imm(-1), i});
+    a.emit(OpJit, {i, A::imm(top)});
+    a.emit(OpHcf);
+
+    return {"echo", n, a.finish(), std::vector<Word>(n, 7), 7 * int64_t(n), 4 * static_cast<unsigned long>(n) + 1};
+}
+
+// Walk span words past the end of the program passes times, summing each
+// word then flipping it between 0 and 1. The walk rewrites its own operands
+// to move along. Needs span words of ram after the program.
+template<typename Word>
+Workload<Word> memory_walk(long span, long passes)
+{
+    using A = Assembler<Word>;
+    A a;
+    auto acc = a.variable(0);
+    auto k = a.variable(0);
+    auto p = a.variable(passes);
+
+    Word outer = a.here();
+    Word reset = a.emit(OpAdd, {A::end(), A::imm(0), A::pos(0)});
+    a.emit(OpAdd, {A::end(), A::imm(0), A::pos(0)});
+    a.emit(OpAdd, {A::end(), A::imm(0), A::pos(0)});
+    a.emit(OpAdd, {A::imm(span), A::imm(0), k});
+
+    Word inner = a.here();
+    Word sum = a.emit(OpAdd, {acc, A::pos(0), acc});
+    Word bump = a.emit(OpEq, {A::pos(0), A::imm(0), A::pos(0)});
+    a.emit(OpAdd, {A::pos(sum + 2), A::imm(1), A::pos(sum + 2)});
+    a.emit(OpAdd, {A::pos(bump + 1), A::imm(1), A::pos(bump + 1)});
+    a.emit(OpAdd, {A::pos(bump + 3), A::imm(1), A::pos(bump + 3)});
+    a.emit(OpAdd, {k, A::imm(-1), k});
+    a.emit(OpJit, {k, A::imm(inner)});
+    a.emit(OpAdd, {p, A::imm(-1), p});
+    a.emit(OpJit, {p, A::imm(outer)});
+    a.emit(OpOut, {acc});
+    a.emit(OpHcf);
+
+    // Point the resets at the operands they move back to the start
+    a.patch(reset + 3, sum + 2);
+    a.patch(reset + 7, bump + 1);
+    a.patch(reset + 11, bump + 3);
+
+    unsigned long instructions = passes * (7 * static_cast<unsigned long>(span) + 6) + 2;
+    return {"memory walk", span, a.finish(), {}, int64_t(span) * (passes / 2), instructions};
+}
+
+// The standard corpus at growing sizes, limited to what fits in ram words
+// and whether the computer has a relative base
+template<typename Word>
+std::vector<Workload<Word>> workload_suite(long ram, bool relative_base)
+{
+    std::vector<Workload<Word>> suite;
+    for (long n : {100000L, 1000000L, 10000000L})
+    {
+        suite.push_back(arithmetic_loop<Word>(n));
+    }
+    for (long n : {100000L, 1000000L, 10000000L})
+    {
+        suite.push_back(self_modifying<Word>(n));
+    }
+    for (long n : {10000L, 100000L, 1000000L})
+    {
+        suite.push_back(echo<Word>(n));
+    }
+    for (long span : {ram / 8, ram / 4, ram / 2})
+    {
+        suite.push_back(memory_walk<Word>(span, 10000000 / span));
+    }
+    if (relative_base)
+    {
+        for (long depth : {ram / 32, ram / 16, ram / 8})
+        {
+            suite.push_back(recursion<Word>(depth, 10000000 / depth));
+        }
+    }
+
+    return suite;
+}
+
+// Time run on every workload, which returns the sum of the outputs, and
+// report instructions per second
+template<typename Word, typename Run>
+void run_workloads(const std::string &computer, const std::vector<Workload<Word>> &suite, Run run)
+{
+    for (const Workload<Word> &workload : suite)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int64_t result = run(workload);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << computer << " " << workload.name << " " << workload.size << ": "
+                  << workload.instructions / elapsed.count() / 1e6 << " M instructions/s"
+                  << ((result == workload.expected) ? "" : " WRONG") << std::endl;
+    }
+}
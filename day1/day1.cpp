@@ -1,7 +1,27 @@
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <vector>
+#include <array>
+#include <random>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
 #include <cassert>
+#include <immintrin.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "day1.hpp"
 
 // Fuel required to launch a given module is based on its mass.
@@ -14,26 +34,705 @@
 // fuel should instead be treated as if it requires zero fuel; the remaining
 // mass, if any, is instead handled by wishing really hard, which has no mass
 // and is outside the scope of this calculation.
-int mass_to_fuel(const int& mass, const bool& include_fuel)
+constexpr int mass_to_fuel(const int& mass, const bool& include_fuel)
 {
-    if (mass < 6)
+    int total{0};
+    int fuel{mass};
+
+    do
     {
-        return 0;
+        fuel = (fuel < 6) ? 0 : ((fuel / 3) - 2);
+        total += fuel;
+    } while (include_fuel && fuel);
+
+    return total;
+}
+
+// Total fuel for a whole manifest. Given a std::array the sum can happen at
+// compile time.
+template <std::size_t N>
+constexpr int manifest_fuel(const std::array<int, N> &masses, bool include_fuel)
+{
+    int total{0};
+    for (int mass : masses)
+    {
+        total += mass_to_fuel(mass, include_fuel);
+    }
+
+    return total;
+}
+
+// The puzzle answers only depend on constants, so regressions fail the build
+static_assert(3406432 == manifest_fuel(kInputs, false), "part 1 answer changed");
+static_assert(5106777 == manifest_fuel(kInputs, true), "part 2 answer changed");
+
+static_assert(2 == mass_to_fuel(12, false) && 654 == mass_to_fuel(1969, false), "part 1 examples");
+static_assert(966 == mass_to_fuel(1969, true) && 50346 == mass_to_fuel(100756, true), "part 2 examples");
+
+// x / 3 for any 32 bit unsigned x, as a multiply and shift
+inline uint32_t divide_by_3(uint32_t x)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(x) * 0xAAAAAAABu) >> 33);
+}
+
+uint64_t total_fuel_scalar(const int *masses, size_t count, bool include_fuel)
+{
+    uint64_t total{0};
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t fuel = std::max(masses[i], 0);
+        do
+        {
+            fuel = (fuel < 6) ? 0 : (divide_by_3(fuel) - 2);
+            total += fuel;
+        } while (include_fuel && fuel);
+    }
+
+    return total;
+}
+
+// One fuel step on eight masses. There's no 32 bit high multiply, so the
+// even and odd lanes are divided separately with 64 bit products and blended
+// back together.
+__attribute__((target("avx2")))
+inline __m256i fuel_step_avx2(__m256i mass)
+{
+    const __m256i magic = _mm256_set1_epi32(0xAAAAAAAB);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(mass, magic), 33);
+    __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(mass, 32), magic), 33);
+    __m256i fuel = _mm256_sub_epi32(_mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA), _mm256_set1_epi32(2));
+
+    // Masses under 6 need no fuel
+    return _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), fuel), fuel);
+}
+
+__attribute__((target("avx2")))
+uint64_t total_fuel_avx2(const int *masses, size_t count, bool include_fuel)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i totals = _mm256_setzero_si256();
+    size_t i{0};
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i mass = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(masses + i));
+        __m256i fuel = fuel_step_avx2(_mm256_max_epi32(mass, zero));
+        __m256i sum = fuel;
+        while (include_fuel && !_mm256_testz_si256(fuel, fuel))
+        {
+            fuel = fuel_step_avx2(fuel);
+            sum = _mm256_add_epi32(sum, fuel);
+        }
+
+        // A mass's total is at most half of it, so lanes only widen here
+        totals = _mm256_add_epi64(totals, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sum)));
+        totals = _mm256_add_epi64(totals, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sum, 1)));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), totals);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + total_fuel_scalar(masses + i, count - i, include_fuel);
+}
+
+// GCC's AVX-512 headers trip its own uninitialized warnings when used
+// through a target attribute
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// The same step on sixteen masses, clamping through a compare mask
+__attribute__((target("avx512f")))
+inline __m512i fuel_step_avx512(__m512i mass)
+{
+    const __m512i magic = _mm512_set1_epi32(0xAAAAAAAB);
+    __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(mass, magic), 33);
+    __m512i odd = _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(mass, 32), magic), 33);
+    __m512i fuel = _mm512_sub_epi32(_mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32)), _mm512_set1_epi32(2));
+
+    // Masses under 6 need no fuel
+    return _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(fuel, _mm512_setzero_si512()), fuel);
+}
+
+__attribute__((target("avx512f")))
+uint64_t total_fuel_avx512(const int *masses, size_t count, bool include_fuel)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i totals = _mm512_setzero_si512();
+    size_t i{0};
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i mass = _mm512_loadu_si512(masses + i);
+        __m512i fuel = fuel_step_avx512(_mm512_max_epi32(mass, zero));
+        __m512i sum = fuel;
+        while (include_fuel && _mm512_test_epi32_mask(fuel, fuel))
+        {
+            fuel = fuel_step_avx512(fuel);
+            sum = _mm512_add_epi32(sum, fuel);
+        }
+
+        totals = _mm512_add_epi64(totals, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(sum)));
+        totals = _mm512_add_epi64(totals, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(sum, 1)));
+    }
+
+    return _mm512_reduce_add_epi64(totals) + total_fuel_scalar(masses + i, count - i, include_fuel);
+}
+
+#pragma GCC diagnostic pop
+
+typedef uint64_t (*FuelKernel)(const int *, size_t, bool);
+
+// Every kernel this cpu can run, narrowest first
+std::vector<std::pair<const char *, FuelKernel>> available_fuel_kernels()
+{
+    std::vector<std::pair<const char *, FuelKernel>> kernels{{"scalar", &total_fuel_scalar}};
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", &total_fuel_avx2});
+    }
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernels.push_back({"avx512", &total_fuel_avx512});
+    }
+
+    return kernels;
+}
+
+uint64_t total_fuel(const int *masses, size_t count, bool include_fuel)
+{
+    // The widest kernel, picked once
+    static const FuelKernel kernel = available_fuel_kernels().back().second;
+    return kernel(masses, count, include_fuel);
+}
+
+// Total part 2 fuel for every mass below a bound. Fuel chains run through
+// the same small masses over and over, so with the table a larger mass only
+// takes divisions until it drops under the bound, usually just one.
+// Filling lazily only computes the entries masses actually reach, but then
+// one table can't be shared between threads.
+class FuelTable
+{
+public:
+    explicit FuelTable(int bound, bool lazy = false) : table(std::max(bound, 1), lazy ? kUnfilled : 0)
+    {
+        if (!lazy)
+        {
+            // Fuel is always less than its mass, so every entry's chain is
+            // already filled
+            for (int mass = 6; mass < bound; mass++)
+            {
+                uint32_t fuel = divide_by_3(mass) - 2;
+                table[mass] = fuel + table[fuel];
+            }
+        }
+    };
+
+    uint32_t total(int mass)
+    {
+        uint32_t clamped = std::max(mass, 0);
+        uint32_t sum{0};
+        while (clamped >= table.size())
+        {
+            clamped = (clamped < 6) ? 0 : divide_by_3(clamped) - 2;
+            sum += clamped;
+        }
+
+        return sum + lookup(clamped);
+    };
+
+    uint64_t total(const int *masses, size_t count)
+    {
+        uint64_t sum{0};
+        for (size_t i = 0; i < count; i++)
+        {
+            sum += total(masses[i]);
+        }
+
+        return sum;
+    };
+
+    size_t bytes() const
+    {
+        return table.size() * sizeof(uint32_t);
+    };
+
+private:
+    static const uint32_t kUnfilled{UINT32_MAX};
+
+    uint32_t lookup(uint32_t mass)
+    {
+        if (table[mass] == kUnfilled)
+        {
+            uint32_t fuel = (mass < 6) ? 0 : divide_by_3(mass) - 2;
+            table[mass] = fuel ? fuel + lookup(fuel) : 0;
+        }
+
+        return table[mass];
+    };
+
+    std::vector<uint32_t> table;
+};
+
+// Fuel rules for one class of vehicle: fuel is mass / divisor - offset, and
+// any fuel at or below floor counts as none. Division is a multiply by a
+// precomputed magic number and a shift, the same trick as divide_by_3 but
+// worked out at runtime for any divisor.
+class FuelModel
+{
+public:
+    FuelModel(uint32_t divisor = 3, uint32_t offset = 2, uint32_t floor = 0) :
+        divisor(divisor), offset(offset)
+    {
+        // Every step has to shrink the mass or part 2 never ends
+        if (divisor == 0 || (divisor == 1 && offset == 0) || divisor > (1u << 31))
+        {
+            throw std::invalid_argument("fuel model never reaches zero");
+        }
+
+        // Masses are below 2^31, so with l = ceil(log2(divisor)) the magic
+        // number ceil(2^(31 + l) / divisor) fits in 32 bits and the quotient
+        // is exact for all of them
+        int l = (divisor == 1) ? 0 : 64 - __builtin_clzll(divisor - 1);
+        shift = 31 + l;
+        magic = ((uint64_t(1) << shift) + divisor - 1) / divisor;
+
+        // Fuel passes if the quotient is over offset + floor, which only
+        // ever gets compared against quotients below 2^31
+        threshold = std::min<uint64_t>(uint64_t(offset) + floor, INT32_MAX);
+    };
+
+    uint32_t quotient(uint32_t mass) const
+    {
+        return static_cast<uint32_t>((mass * magic) >> shift);
+    };
+
+    // Fuel for one mass, or for the mass and all of its fuel
+    uint64_t fuel(int mass, bool include_fuel) const
+    {
+        uint64_t total{0};
+        uint32_t step = std::max(mass, 0);
+
+        do
+        {
+            uint32_t q = quotient(step);
+            step = (q > threshold) ? q - offset : 0;
+            total += step;
+        } while (include_fuel && step);
+
+        return total;
+    };
+
+    uint64_t total(const int *masses, size_t count, bool include_fuel) const;
+
+    uint32_t divisor;
+    uint32_t offset;
+    uint32_t threshold;
+    uint64_t magic;
+    int shift;
+};
+
+uint64_t model_fuel_scalar(const FuelModel &model, const int *masses, size_t count, bool include_fuel)
+{
+    uint64_t total{0};
+    for (size_t i = 0; i < count; i++)
+    {
+        total += model.fuel(masses[i], include_fuel);
+    }
+
+    return total;
+}
+
+// The fixed kernels with the model's constants in registers
+__attribute__((target("avx2")))
+inline __m256i model_step_avx2(__m256i mass, __m256i magic, __m128i shift, __m256i offset, __m256i threshold)
+{
+    __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(mass, magic), shift);
+    __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(mass, 32), magic), shift);
+    __m256i q = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+
+    return _mm256_and_si256(_mm256_cmpgt_epi32(q, threshold), _mm256_sub_epi32(q, offset));
+}
+
+__attribute__((target("avx2")))
+uint64_t model_fuel_avx2(const FuelModel &model, const int *masses, size_t count, bool include_fuel)
+{
+    const __m256i magic = _mm256_set1_epi64x(model.magic);
+    const __m128i shift = _mm_cvtsi32_si128(model.shift);
+    const __m256i offset = _mm256_set1_epi32(model.offset);
+    const __m256i threshold = _mm256_set1_epi32(model.threshold);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i totals = _mm256_setzero_si256();
+    size_t i{0};
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i mass = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(masses + i));
+        __m256i fuel = model_step_avx2(_mm256_max_epi32(mass, zero), magic, shift, offset, threshold);
+        __m256i sum = fuel;
+        while (include_fuel && !_mm256_testz_si256(fuel, fuel))
+        {
+            fuel = model_step_avx2(fuel, magic, shift, offset, threshold);
+            sum = _mm256_add_epi32(sum, fuel);
+        }
+
+        totals = _mm256_add_epi64(totals, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sum)));
+        totals = _mm256_add_epi64(totals, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sum, 1)));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), totals);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + model_fuel_scalar(model, masses + i, count - i, include_fuel);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+inline __m512i model_step_avx512(__m512i mass, __m512i magic, __m128i shift, __m512i offset, __m512i threshold)
+{
+    __m512i even = _mm512_srl_epi64(_mm512_mul_epu32(mass, magic), shift);
+    __m512i odd = _mm512_srl_epi64(_mm512_mul_epu32(_mm512_srli_epi64(mass, 32), magic), shift);
+    __m512i q = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+
+    return _mm512_maskz_sub_epi32(_mm512_cmpgt_epi32_mask(q, threshold), q, offset);
+}
+
+__attribute__((target("avx512f")))
+uint64_t model_fuel_avx512(const FuelModel &model, const int *masses, size_t count, bool include_fuel)
+{
+    const __m512i magic = _mm512_set1_epi64(model.magic);
+    const __m128i shift = _mm_cvtsi32_si128(model.shift);
+    const __m512i offset = _mm512_set1_epi32(model.offset);
+    const __m512i threshold = _mm512_set1_epi32(model.threshold);
+    const __m512i zero = _mm512_setzero_si512();
+
+    __m512i totals = _mm512_setzero_si512();
+    size_t i{0};
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i mass = _mm512_loadu_si512(masses + i);
+        __m512i fuel = model_step_avx512(_mm512_max_epi32(mass, zero), magic, shift, offset, threshold);
+        __m512i sum = fuel;
+        while (include_fuel && _mm512_test_epi32_mask(fuel, fuel))
+        {
+            fuel = model_step_avx512(fuel, magic, shift, offset, threshold);
+            sum = _mm512_add_epi32(sum, fuel);
+        }
+
+        totals = _mm512_add_epi64(totals, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(sum)));
+        totals = _mm512_add_epi64(totals, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(sum, 1)));
+    }
+
+    return _mm512_reduce_add_epi64(totals) + model_fuel_scalar(model, masses + i, count - i, include_fuel);
+}
+
+#pragma GCC diagnostic pop
+
+typedef uint64_t (*ModelKernel)(const FuelModel &, const int *, size_t, bool);
+
+std::vector<std::pair<const char *, ModelKernel>> available_model_kernels()
+{
+    std::vector<std::pair<const char *, ModelKernel>> kernels{{"scalar", &model_fuel_scalar}};
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", &model_fuel_avx2});
+    }
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        kernels.push_back({"avx512", &model_fuel_avx512});
+    }
+
+    return kernels;
+}
+
+uint64_t FuelModel::total(const int *masses, size_t count, bool include_fuel) const
+{
+    // With a divisor of 1 a mass's part 2 total can pass 32 bits, too much
+    // for a vector lane
+    if (divisor == 1 && include_fuel)
+    {
+        return model_fuel_scalar(*this, masses, count, include_fuel);
+    }
+
+    static const ModelKernel kernel = available_model_kernels().back().second;
+    return kernel(*this, masses, count, include_fuel);
+}
+
+// Fuel totals for a manifest that keeps changing. Every edit adjusts both
+// totals by the fuel of the masses it touches, so nothing is ever summed
+// again. Edits are serialized, and any number of readers can take a
+// consistent snapshot of the totals without locking through a seqlock.
+class FuelLedger
+{
+public:
+    struct Snapshot
+    {
+        uint64_t part1;
+        uint64_t part2;
+        uint64_t count;
+    };
+
+    size_t insert(int mass)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+
+        size_t id;
+        if (free_ids.empty())
+        {
+            id = masses.size();
+            masses.push_back(mass);
+            live.push_back(true);
+        }
+        else
+        {
+            id = free_ids.back();
+            free_ids.pop_back();
+            masses[id] = mass;
+            live[id] = true;
+        }
+
+        publish(mass_to_fuel(mass, false), mass_to_fuel(mass, true), 1);
+        return id;
+    };
+
+    void remove(size_t id)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        check(id);
+
+        live[id] = false;
+        free_ids.push_back(id);
+        publish(-int64_t(mass_to_fuel(masses[id], false)), -int64_t(mass_to_fuel(masses[id], true)), -1);
+    };
+
+    void update(size_t id, int mass)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        check(id);
+
+        publish(int64_t(mass_to_fuel(mass, false)) - mass_to_fuel(masses[id], false),
+                int64_t(mass_to_fuel(mass, true)) - mass_to_fuel(masses[id], true), 0);
+        masses[id] = mass;
+    };
+
+    // Retries while an edit is in progress, never blocks one
+    Snapshot snapshot() const
+    {
+        while (true)
+        {
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            Snapshot totals{part1.load(std::memory_order_relaxed), part2.load(std::memory_order_relaxed),
+                            count.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (!(before & 1) && before == sequence.load(std::memory_order_relaxed))
+            {
+                return totals;
+            }
+        }
+    };
+
+private:
+    void check(size_t id) const
+    {
+        if (id >= masses.size() || !live[id])
+        {
+            throw std::out_of_range("no such module");
+        }
+    };
+
+    // An odd sequence number marks an edit in progress
+    void publish(int64_t part1_delta, int64_t part2_delta, int64_t count_delta)
+    {
+        uint64_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        part1.store(part1.load(std::memory_order_relaxed) + part1_delta, std::memory_order_relaxed);
+        part2.store(part2.load(std::memory_order_relaxed) + part2_delta, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + count_delta, std::memory_order_relaxed);
+
+        sequence.store(start + 2, std::memory_order_release);
+    };
+
+    std::mutex writer;
+    std::vector<int> masses;
+    std::vector<bool> live;
+    std::vector<size_t> free_ids; // Removed ids, reused by insert
+
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> part1{0};
+    std::atomic<uint64_t> part2{0};
+    std::atomic<uint64_t> count{0};
+};
+
+struct FuelTotals
+{
+    uint64_t part1{0};
+    uint64_t part2{0};
+};
+
+// Value of a line of 1 to 7 digits followed by a newline, read 8 bytes at a
+// time, or -1 if the line is anything else
+inline int parse_short_line(const char *p, size_t &length)
+{
+    uint64_t chunk;
+    std::memcpy(&chunk, p, sizeof(chunk));
+
+    // The high bit of a byte is set if it isn't a digit. Bytes after the
+    // first non-digit may be garbage from borrows, but they're never looked at.
+    uint64_t digits = chunk - 0x3030303030303030;
+    uint64_t other = (digits | (digits + 0x7676767676767676)) & 0x8080808080808080;
+    if (!other)
+    {
+        return -1;
     }
 
-    int fuel = ((mass / 3) - 2);
+    length = __builtin_ctzll(other) / 8;
+    if (length == 0 || p[length] != '\n')
+    {
+        return -1;
+    }
+
+    // Line the digits up against the top byte, then combine pairs, quads and
+    // octets
+    uint64_t value = digits << (64 - 8 * length);
+    value = (value * 10 + (value >> 8)) & 0x00FF00FF00FF00FF;
+    value = (value * 100 + (value >> 16)) & 0x0000FFFF0000FFFF;
+    value = (value * 10000 + (value >> 32)) & 0x00000000FFFFFFFF;
+    return static_cast<int>(value);
+}
+
+// Parse newline separated masses and total both parts as they go. Masses are
+// gathered a block at a time so the kernels work on them while they're still
+// in cache, and the blocks are big enough that the vector units stay warmed
+// up between them. Nothing else is kept.
+FuelTotals fuel_totals(const char *begin, const char *end)
+{
+    const size_t kBlock{65536};
+    static thread_local int block[kBlock];
+    size_t count{0};
+    FuelTotals totals;
+
+    auto flush = [&] {
+        totals.part1 += total_fuel(block, count, false);
+        totals.part2 += total_fuel(block, count, true);
+        count = 0;
+    };
+
+    auto push = [&](int mass) {
+        block[count++] = mass;
+        if (count == kBlock)
+        {
+            flush();
+        }
+    };
+
+    const char *p = begin;
+    while (p < end)
+    {
+        size_t length;
+        int mass = (end - p >= 8) ? parse_short_line(p, length) : -1;
+        if (mass >= 0)
+        {
+            push(mass);
+            p += length + 1;
+            continue;
+        }
+
+        // Anything else through from_chars, which takes a sign and refuses
+        // numbers too big for an int. Lines without a mass are skipped.
+        auto [next, ec] = std::from_chars(p, end, mass);
+
+        // Skip to the next line, which also steps over blank lines and \r
+        p = next;
+        while (p < end && *p++ != '\n')
+        {
+        }
+
+        if (ec == std::errc())
+        {
+            push(mass);
+        }
+    }
+    flush();
+
+    return totals;
+}
+
+// Map a mass file and total it in one chunk per thread. Chunks are cut at
+// the first newline after an even split so no line is parsed twice.
+bool fuel_totals_file(const char *path, FuelTotals &totals, unsigned threads = std::thread::hardware_concurrency())
+{
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+
+    totals = FuelTotals{};
+    size_t size = info.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    const char *end = data + size;
+    threads = std::max(1u, std::min<unsigned>(threads, size / 4096 + 1));
+
+    std::vector<const char *> cuts{data};
+    for (unsigned i = 1; i < threads; i++)
+    {
+        const char *cut = std::max(data + size / threads * i, cuts.back());
+        while (cut < end && *(cut - 1) != '\n')
+        {
+            cut++;
+        }
+        cuts.push_back(cut);
+    }
+    cuts.push_back(end);
 
-    if (include_fuel)
+    std::vector<FuelTotals> partials(threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
     {
-        return fuel + mass_to_fuel(fuel, true);
+        workers.emplace_back([&, i] { partials[i] = fuel_totals(cuts[i], cuts[i + 1]); });
     }
-    else
+    for (std::thread &worker : workers)
     {
-        return fuel;
+        worker.join();
     }
+
+    for (const FuelTotals &partial : partials)
+    {
+        totals.part1 += partial.part1;
+        totals.part2 += partial.part2;
+    }
+
+    munmap(mapped, size);
+    return true;
 }
 
-int part1(std::vector<int> input)
+template <typename Masses>
+int part1(const Masses &input)
 {
     const bool include_fuel = false;
     // For a mass of 12, divide by 3 and round down to get 4,
@@ -47,16 +746,11 @@ int part1(std::vector<int> input)
     // For a mass of 100756, the fuel required is 33583.
     assert(33583 == mass_to_fuel(100756, include_fuel));
 
-    // Transform the original mass into the fuel required
-    std::vector<int> fuel_counts;
-    std::transform(input.begin(), input.end(), std::back_inserter(fuel_counts),
-                   [include_fuel](const int &n) { return mass_to_fuel(n, include_fuel); });
-
-    // Sum all the fuel counts for a total
-    return std::accumulate(fuel_counts.begin(), fuel_counts.end(), 0);
+    return total_fuel(input.data(), input.size(), include_fuel);
 }
 
-int part2(std::vector<int> input)
+template <typename Masses>
+int part2(const Masses &input)
 {
     const bool include_fuel = true;
     // A module of mass 14 requires 2 fuel. This fuel requires no further fuel
@@ -73,22 +767,407 @@ int part2(std::vector<int> input)
     // 33583 + 11192 + 3728 + 1240 + 411 + 135 + 43 + 12 + 2 = 50346.
     assert(50346 == mass_to_fuel(100756, include_fuel));
 
-    // Transform the original mass into the fuel required
-    std::vector<int> fuel_counts;
-    std::transform(input.begin(), input.end(), std::back_inserter(fuel_counts),
-                   [include_fuel](const int &n) { return mass_to_fuel(n, include_fuel); });
+    return total_fuel(input.data(), input.size(), include_fuel);
+}
+
+// Every kernel this cpu has agrees with mass_to_fuel
+void test_kernels()
+{
+    std::vector<int> masses{INT_MAX, INT_MIN, -1, 0, 1, 5, 6, 7, 8, 9, 12, 14, 1969, 100756};
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(0, 1 << 20);
+    for (int i = 0; i < 1000; i++)
+    {
+        masses.push_back(mass(random));
+    }
+
+    for (bool include_fuel : {false, true})
+    {
+        // Every length up to a few vectors, to cover the scalar tails
+        for (size_t count = 0; count < 40; count++)
+        {
+            uint64_t expected{0};
+            for (size_t i = 0; i < count; i++)
+            {
+                expected += mass_to_fuel(masses[i], include_fuel);
+            }
+            for (const auto &[name, kernel] : available_fuel_kernels())
+            {
+                assert(expected == kernel(masses.data(), count, include_fuel));
+            }
+        }
 
-    // Sum all the fuel counts for a total
-    return std::accumulate(fuel_counts.begin(), fuel_counts.end(), 0);
+        uint64_t expected{0};
+        for (int m : masses)
+        {
+            expected += mass_to_fuel(m, include_fuel);
+        }
+        for (const auto &[name, kernel] : available_fuel_kernels())
+        {
+            assert(expected == kernel(masses.data(), masses.size(), include_fuel));
+        }
+    }
 }
 
-int main()
+void kernel_benchmark()
 {
-    int p1_total_fuel = part1(kInputs);
-    assert(3406432 == p1_total_fuel);
+    std::vector<int> masses(100000000);
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(50000, 150000);
+    std::generate(masses.begin(), masses.end(), [&] { return mass(random); });
+
+    for (const auto &[name, kernel] : available_fuel_kernels())
+    {
+        for (bool include_fuel : {false, true})
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t total = kernel(masses.data(), masses.size(), include_fuel);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << name << (include_fuel ? " part 2: " : " part 1: ") << total << ", "
+                      << masses.size() / elapsed.count() / 1e6 << " M masses/s" << std::endl;
+        }
+    }
+}
+
+// Lookups match mass_to_fuel whatever the bound, filled up front or lazily
+void test_fuel_table()
+{
+    std::vector<int> masses{INT_MAX, INT_MIN, -1, 0, 5, 6, 7, 14, 1969, 100756};
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(0, 1 << 24);
+    for (int i = 0; i < 1000; i++)
+    {
+        masses.push_back(mass(random));
+    }
+
+    for (int bound : {1, 6, 100, 1 << 16, 1 << 20})
+    {
+        for (bool lazy : {false, true})
+        {
+            FuelTable table(bound, lazy);
+            uint64_t expected{0};
+            for (int m : masses)
+            {
+                assert(static_cast<uint32_t>(mass_to_fuel(m, true)) == table.total(m));
+                expected += mass_to_fuel(m, true);
+            }
+            assert(expected == table.total(masses.data(), masses.size()));
+        }
+    }
+}
+
+// Part 2 through tables of growing size against the best kernel, with masses
+// from the puzzle's range. Below the top of the range most masses need one
+// division before a hit, above it every mass is a straight lookup.
+void table_benchmark()
+{
+    std::vector<int> masses(100000000);
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(50000, 150000);
+    std::generate(masses.begin(), masses.end(), [&] { return mass(random); });
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t expected = total_fuel(masses.data(), masses.size(), true);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "compute: " << masses.size() / elapsed.count() / 1e6 << " M masses/s" << std::endl;
+
+    for (int bound : {1 << 10, 1 << 14, 1 << 16, 50000, 150001, 1 << 20, 1 << 24})
+    {
+        start = std::chrono::steady_clock::now();
+        FuelTable table(bound);
+        std::chrono::duration<double> build = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        uint64_t total = table.total(masses.data(), masses.size());
+        elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "table below " << bound << " (" << table.bytes() / 1024 << " KiB, built in "
+                  << build.count() * 1e3 << "ms): " << masses.size() / elapsed.count() / 1e6 << " M masses/s"
+                  << ((total == expected) ? "" : " WRONG") << std::endl;
+    }
+}
+
+// Models agree with a plain division, and the default model is the puzzle's
+void test_fuel_model()
+{
+    std::vector<int> masses{INT_MAX, INT_MAX - 1, INT_MIN, -1, 0, 1, 5, 6, 7, 14, 1969, 100756};
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(0, INT_MAX);
+    for (int i = 0; i < 1000; i++)
+    {
+        masses.push_back(mass(random));
+    }
+
+    std::vector<int> small;
+    for (int m : masses)
+    {
+        small.push_back(m % 100000);
+    }
+
+    FuelModel puzzle;
+    assert(3406432 == puzzle.total(kInputs.data(), kInputs.size(), false));
+    assert(5106777 == puzzle.total(kInputs.data(), kInputs.size(), true));
+
+    for (uint32_t divisor : {1u, 2u, 3u, 4u, 7u, 10u, 641u, 65537u, 1u << 31})
+    {
+        FuelModel model(divisor, 3, 1);
+        for (bool include_fuel : {false, true})
+        {
+            // A divisor of 1 only takes 3 off each step, so keep to small masses
+            const std::vector<int> &sample = (divisor == 1 && include_fuel) ? small : masses;
+
+            uint64_t expected{0};
+            for (int m : sample)
+            {
+
+                uint64_t total{0};
+                int64_t step = std::max(m, 0);
+                do
+                {
+                    step = step / divisor - 3;
+                    step = (step > 1) ? step : 0;
+                    total += step;
+                } while (include_fuel && step);
+
+                assert(total == model.fuel(m, include_fuel));
+                expected += total;
+            }
+
+            for (const auto &[name, kernel] : available_model_kernels())
+            {
+                if (divisor > 1 || !include_fuel)
+                {
+                    assert(expected == kernel(model, sample.data(), sample.size(), include_fuel));
+                }
+            }
+            assert(expected == model.total(sample.data(), sample.size(), include_fuel));
+        }
+    }
+
+    bool thrown{false};
+    try
+    {
+        FuelModel endless(1, 0);
+    }
+    catch (const std::invalid_argument &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// A runtime model against the hardcoded kernels on the same masses
+void model_benchmark()
+{
+    std::vector<int> masses(100000000);
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(50000, 150000);
+    std::generate(masses.begin(), masses.end(), [&] { return mass(random); });
+
+    FuelModel model;
+    for (const auto &[name, kernel] : available_model_kernels())
+    {
+        for (bool include_fuel : {false, true})
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t total = kernel(model, masses.data(), masses.size(), include_fuel);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << "model " << name << (include_fuel ? " part 2: " : " part 1: ") << total << ", "
+                      << masses.size() / elapsed.count() / 1e6 << " M masses/s" << std::endl;
+        }
+    }
+}
+
+void test_ledger()
+{
+    FuelLedger ledger;
+    std::vector<size_t> ids;
+    for (int mass : kInputs)
+    {
+        ids.push_back(ledger.insert(mass));
+    }
+
+    FuelLedger::Snapshot totals = ledger.snapshot();
+    assert(3406432 == totals.part1 && 5106777 == totals.part2 && kInputs.size() == totals.count);
+
+    // Swap the first module for the example masses one at a time
+    ledger.update(ids[0], 1969);
+    size_t added = ledger.insert(100756);
+    ledger.remove(ids[1]);
+    totals = ledger.snapshot();
+    assert(3406432 - mass_to_fuel(kInputs[0], false) - mass_to_fuel(kInputs[1], false) + 654 + 33583 == totals.part1);
+    assert(5106777 - mass_to_fuel(kInputs[0], true) - mass_to_fuel(kInputs[1], true) + 966 + 50346 == totals.part2);
+    assert(kInputs.size() == totals.count);
+
+    // Removed ids get reused
+    size_t reused = ledger.insert(kInputs[1]);
+    assert(ids[1] == reused);
+    ledger.update(ids[0], kInputs[0]);
+    ledger.remove(added);
+    totals = ledger.snapshot();
+    assert(3406432 == totals.part1 && 5106777 == totals.part2);
+
+    bool thrown{false};
+    try
+    {
+        ledger.remove(added);
+    }
+    catch (const std::out_of_range &)
+    {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // A writer flips one module between two masses while readers check they
+    // only ever see one of the two sets of totals
+    FuelLedger::Snapshot a = ledger.snapshot();
+    ledger.update(ids[0], 1969);
+    FuelLedger::Snapshot b = ledger.snapshot();
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; i++)
+    {
+        readers.emplace_back([&] {
+            while (!done)
+            {
+                FuelLedger::Snapshot seen = ledger.snapshot();
+                assert((seen.part1 == a.part1 && seen.part2 == a.part2) ||
+                       (seen.part1 == b.part1 && seen.part2 == b.part2));
+            }
+        });
+    }
+    for (int i = 0; i < 100000; i++)
+    {
+        ledger.update(ids[0], (i % 2) ? 1969 : kInputs[0]);
+    }
+    done = true;
+    for (std::thread &reader : readers)
+    {
+        reader.join();
+    }
+}
+
+// The puzzle input through a file gives the same answers however it's split
+void test_file()
+{
+    char path[] = "/tmp/day1_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+
+    std::string text;
+    for (int mass : kInputs)
+    {
+        text += std::to_string(mass) + ((mass % 2) ? "\r\n" : "\n\n");
+    }
+    text += "1969";
+    ssize_t written = write(fd, text.data(), text.size());
+    assert(static_cast<ssize_t>(text.size()) == written);
+    close(fd);
+
+    for (unsigned threads : {1u, 2u, 3u, 7u, 16u})
+    {
+        FuelTotals totals;
+        bool read = fuel_totals_file(path, totals, threads);
+        assert(read);
+        assert(3406432 + 654 == totals.part1);
+        assert(5106777 + 966 == totals.part2);
+    }
+
+    // Short and long lines, signs, a number too big for an int, which is
+    // skipped, and a missing final newline
+    std::string lines("12\n14\n1234567\n12345678\n-5\n\n99999999999999999999\n7");
+    FuelTotals totals = fuel_totals(lines.data(), lines.data() + lines.size());
+    for (bool include_fuel : {false, true})
+    {
+        uint64_t expected{0};
+        for (int mass : {12, 14, 1234567, 12345678, -5, 7})
+        {
+            expected += mass_to_fuel(mass, include_fuel);
+        }
+        assert(expected == (include_fuel ? totals.part2 : totals.part1));
+    }
+
+    unlink(path);
+    FuelTotals missing;
+    assert(!fuel_totals_file(path, missing));
+}
+
+void file_benchmark()
+{
+    char path[] = "/tmp/day1_XXXXXX";
+    int fd = mkstemp(path);
+    std::mt19937 random(2019);
+    std::uniform_int_distribution<int> mass(50000, 150000);
+
+    // 50M masses, about 350MB
+    std::string text;
+    for (int chunk = 0; chunk < 50; chunk++)
+    {
+        text.clear();
+        for (int i = 0; i < 1000000; i++)
+        {
+            text += std::to_string(mass(random));
+            text += '\n';
+        }
+        if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size()))
+        {
+            break;
+        }
+    }
+    close(fd);
+
+    for (unsigned threads : {1u, std::thread::hardware_concurrency()})
+    {
+        FuelTotals totals;
+        auto start = std::chrono::steady_clock::now();
+        fuel_totals_file(path, totals, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "file, " << threads << " threads: " << totals.part1 << " " << totals.part2 << ", "
+                  << 50 / elapsed.count() << " M masses/s" << std::endl;
+    }
+
+    unlink(path);
+}
+
+int main(int argc, char **argv)
+{
+    // Total a mass file instead of the puzzle input
+    if (argc > 1)
+    {
+        FuelTotals totals;
+        if (!fuel_totals_file(argv[1], totals))
+        {
+            std::cerr << "Could not read " << argv[1] << std::endl;
+            return 1;
+        }
+        std::cout << "Part 1: Total fuel required: " << totals.part1 << std::endl;
+        std::cout << "Part 2: Total fuel required: " << totals.part2 << std::endl;
+        return 0;
+    }
+
+    test_kernels();
+    test_file();
+    test_fuel_table();
+    test_fuel_model();
+    test_ledger();
+    // The answers were worked out by the compiler, the runtime kernels only
+    // check they agree
+    constexpr int p1_total_fuel = manifest_fuel(kInputs, false);
+    assert(p1_total_fuel == part1(kInputs));
     std::cout<< "Part 1: Total fuel required: " << p1_total_fuel << std::endl;
 
-    int p2_total_fuel = part2(kInputs);
-    assert(5106777 == p2_total_fuel);
+    constexpr int p2_total_fuel = manifest_fuel(kInputs, true);
+    assert(p2_total_fuel == part2(kInputs));
     std::cout<< "Part 2: Total fuel required: " << p2_total_fuel << std::endl;
+
+#ifdef BENCHMARK
+    kernel_benchmark();
+    model_benchmark();
+    file_benchmark();
+    table_benchmark();
+#endif
 }
\ No newline at end of file
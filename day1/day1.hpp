@@ -1,7 +1,7 @@
-#include <vector>
+#include <array>
 
 // Input data
-static const std::vector<int> kInputs {
+static constexpr std::array kInputs {
 103842,
 72629,
 121232,
@@ -1,6 +1,11 @@
 #include <iostream>
 #include <cassert>
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstddef>
 #include "day2.hpp"
+#include "../common/workloads.hpp"
 
 enum
 {
@@ -9,7 +14,10 @@ enum
     HCF = 99
 } opcodes;
 
-void intcode(std::vector<int> &memory)
+// Works on any random access memory. Given a std::array the whole run can
+// happen at compile time.
+template <typename Memory>
+constexpr void intcode(Memory &memory)
 {
     // Program counter
     auto pc{memory.begin()};
@@ -66,6 +74,38 @@ void intcode(std::vector<int> &memory)
     }
 }
 
+// Set the noun and verb, run the program and read position 0
+template <std::size_t N>
+constexpr int run_program(std::array<int, N> memory, int noun, int verb)
+{
+    memory.at(1) = noun;
+    memory.at(2) = verb;
+    intcode(memory);
+    return memory.at(0);
+}
+
+// Search every noun and verb for the one that produces target
+template <std::size_t N>
+constexpr std::pair<int, int> find_noun_verb(const std::array<int, N> &program, int target)
+{
+    for (int n = 0; n < 100; n++)
+    {
+        for (int v = 0; v < 100; v++)
+        {
+            if (target == run_program(program, n, v))
+            {
+                return std::pair<int, int>(n, v);
+            }
+        }
+    }
+
+    return std::pair<int, int>(0, 0);
+}
+
+// The puzzle answers only depend on constants, so regressions fail the build
+static_assert(7594646 == run_program(kInput, 12, 2), "part 1 answer changed");
+static_assert(std::pair<int, int>(33, 76) == find_noun_verb(kInput, 19690720), "part 2 answer changed");
+
 int part1()
 {
     std::vector<int> input;
@@ -95,33 +135,30 @@ int part1()
     intcode(input);
     assert(validation == input);
 
-    input = kInput;
-    input.at(1) = 12;
-    input.at(2) = 2;
-    intcode(input);
-    return input.at(0);
+    constexpr int result = run_program(kInput, 12, 2);
+    return result;
 }
 
 std::pair<int, int> part2()
 {
-    int validation = 19690720;
-    std::vector<int> input;
-    for (int n = 0; n < 100; n++)
+    constexpr std::pair<int, int> result = find_noun_verb(kInput, 19690720);
+    return result;
+}
+
+// Only straight line code runs here, there are no jumps to loop with
+void workload_benchmark()
+{
+    std::vector<Workload<int>> suite;
+    for (long n : {10000L, 100000L, 1000000L})
     {
-        for (int v = 0; v < 100; v++)
-        {
-            input = kInput;
-            input.at(1) = n;
-            input.at(2) = v;
-            intcode(input);
-            if (validation == input.at(0))
-            {
-                return std::pair<int, int>(n, v);
-            }
-        }
+        suite.push_back(straight_line<int>(n));
     }
 
-    return std::pair<int, int>(0, 0);
+    run_workloads("day2", suite, [](const Workload<int> &workload) {
+        std::vector<int> memory = workload.program;
+        intcode(memory);
+        return static_cast<int64_t>(memory[0]);
+    });
 }
 
 int main()
@@ -134,4 +171,8 @@ int main()
     assert(33 == p2_output.first);
     assert(76 == p2_output.second);
     std::cout<< "Part 2: NounVerb: " << p2_output.first << p2_output.second << std::endl;
+
+#ifdef BENCHMARK
+    workload_benchmark();
+#endif
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
-#include <vector>
+#include <array>
 
-static const std::vector<int> kInput = {
+static constexpr std::array kInput = {
 1,
 0,
 0,
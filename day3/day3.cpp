@@ -2,45 +2,126 @@
 #include <algorithm>
 #include <cassert>
 #include <limits>
+#include <map>
+#include <cstdlib>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <array>
+#include <numeric>
+#include <immintrin.h>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
 #include "day3.hpp"
+#include "../common/tokenize.hpp"
 
 typedef std::pair<int, int> Coord;
 typedef std::vector<Coord> Wire;
 
-std::vector<std::string> tokenize(const std::string &input, const char &token = ',')
+// Steps to the first visit of every coord a wire reaches, in an open
+// addressing table keyed by the coord packed into 64 bits. Lookups are one
+// multiply and usually a single probe, where searching the wire is linear.
+class StepIndex
 {
-    std::vector<std::string> results;
-    std::string current_chunk;
+public:
+    explicit StepIndex(size_t expected = 0)
+    {
+        size_t capacity{16};
+        while (capacity < 2 * expected)
+        {
+            capacity *= 2;
+        }
+        slots.assign(capacity, Slot{});
+    };
 
-    // Iterate and tokenize the input string
-    for (const char &current_character : input)
+    static uint64_t pack(const Coord &coord)
     {
-        if (current_character == token)
+        return (uint64_t(uint32_t(coord.first)) << 32) | uint32_t(coord.second);
+    };
+
+    // Later visits keep the steps of the first
+    void visit(const Coord &coord, long steps)
+    {
+        if (2 * (count + 1) > slots.size())
         {
-            // We found the token, add the current chunk to our results
-            results.push_back(current_chunk);
-            current_chunk.clear();
+            grow();
         }
-        else
+        Slot &slot = slots[probe(pack(coord))];
+        if (slot.steps < 0)
         {
-            // We have not yet found the token, store the current character
-            current_chunk += current_character;
+            slot = {pack(coord), steps};
+            count++;
         }
-    }
-    // Don't forget to flush the current chunk into the results
-    results.push_back(current_chunk);
+    };
 
-    return results;
-}
+    // Steps to the first visit of coord, or -1 if the wire never gets there
+    long find(const Coord &coord) const
+    {
+        return slots[probe(pack(coord))].steps;
+    };
+
+    size_t size() const
+    {
+        return count;
+    };
+
+private:
+    struct Slot
+    {
+        uint64_t key{0};
+        long steps{-1}; // Empty while negative
+    };
+
+    // The slot holding key, or the empty one it would go in. The table is
+    // never more than half full so there's always an empty slot to stop at.
+    size_t probe(uint64_t key) const
+    {
+        const size_t mask = slots.size() - 1;
+        size_t i = (key * 0x9E3779B97F4A7C15ULL) >> shift();
+        while (slots[i].steps >= 0 && slots[i].key != key)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
+    };
+
+    // Fibonacci hashing keeps the high bits of the product, which every bit
+    // of the key feeds into
+    int shift() const
+    {
+        return 64 - __builtin_ctzll(slots.size());
+    };
+
+    void grow()
+    {
+        std::vector<Slot> old(2 * slots.size(), Slot{});
+        old.swap(slots);
+        for (const Slot &slot : old)
+        {
+            if (slot.steps >= 0)
+            {
+                slots[probe(slot.key)] = slot;
+            }
+        }
+    };
 
-Wire rasterize(const std::vector<std::string> &instructions)
+    std::vector<Slot> slots;
+    size_t count{0};
+};
+
+// Every coord the wire passes through in order, starting from the origin.
+// Given an index, the first visit of each coord is recorded in it as well.
+Wire rasterize(const Tokens &instructions, StepIndex *index = nullptr)
 {
     Wire coords{std::make_pair(0, 0)};
 
-    for (const std::string &instruction : instructions)
+    for (std::string_view instruction : instructions)
     {
         const char direction = instruction.at(0);
-        const int num_steps = atoi(instruction.substr(1).data());
+        const int num_steps = parse_int(instruction.substr(1));
 
         if (direction == 'U')
         {
@@ -80,6 +161,15 @@ Wire rasterize(const std::vector<std::string> &instructions)
         }
     };
 
+    if (index != nullptr)
+    {
+        *index = StepIndex(coords.size());
+        for (size_t i = 0; i < coords.size(); i++)
+        {
+            index->visit(coords[i], i);
+        }
+    }
+
     return coords;
 }
 
@@ -95,188 +185,1812 @@ int closest_intersection(std::vector<Coord> &intersections)
     return closest.first + closest.second;
 }
 
-int fewest_steps(std::vector<Coord> &intersections, const Wire &first, const Wire &second)
+long fewest_steps(std::vector<Coord> &intersections, const StepIndex &first, const StepIndex &second)
 {
     intersections.erase(std::find(intersections.begin(), intersections.end(), Coord{0, 0}));
 
-    int min{std::numeric_limits<int>::max()};
+    long min{std::numeric_limits<long>::max()};
     for (const Coord &intersection : intersections)
     {
-        int sum{0};
-        Wire::const_iterator iter = std::find(first.begin(), first.end(), intersection);
-        if (iter != first.end())
+        min = std::min(min, first.find(intersection) + second.find(intersection));
+    }
+
+    return min;
+}
+
+struct CrossingAnswers
+{
+    long distance; // To the crossing nearest the origin
+    long steps;    // Fewest combined steps to a crossing
+};
+
+// Both answers in one walk along the second wire, looking each coord up in
+// the first wire's index. Nothing needs sorting, and the first visit of the
+// second wire to a crossing is the cheapest of its visits anyway.
+CrossingAnswers index_crossings(const StepIndex &first, const Wire &second)
+{
+    CrossingAnswers answers{std::numeric_limits<long>::max(), std::numeric_limits<long>::max()};
+    for (size_t i = 1; i < second.size(); i++)
+    {
+        const long steps = first.find(second[i]);
+        if (steps >= 0 && second[i] != Coord{0, 0})
+        {
+            answers.distance = std::min(answers.distance, std::labs(second[i].first) + std::labs(second[i].second));
+            answers.steps = std::min(answers.steps, steps + long(i));
+        }
+    }
+    return answers;
+}
+
+// Both answers for a pair of wires, from one parse and rasterization of
+// each. The first wire's coords go into a first-visit index, then a single
+// walk along the second wire answers both parts. The rasterized wires and
+// index are kept for anything else that wants them.
+class WireSolver
+{
+public:
+    explicit WireSolver(const std::pair<std::string, std::string> &wires)
+        : first_wire(rasterize(tokenize(wires.first), &first_index)),
+          second_wire(rasterize(tokenize(wires.second))),
+          answers(index_crossings(first_index, second_wire))
+    {
+    };
+
+    // Manhattan distance to the crossing nearest the origin
+    long closest() const
+    {
+        return answers.distance;
+    };
+
+    // Fewest combined steps to a crossing
+    long fewest_steps() const
+    {
+        return answers.steps;
+    };
+
+    const Wire &first() const
+    {
+        return first_wire;
+    };
+
+    const Wire &second() const
+    {
+        return second_wire;
+    };
+
+    const StepIndex &index() const
+    {
+        return first_index;
+    };
+
+private:
+    StepIndex first_index;
+    Wire first_wire;
+    Wire second_wire;
+    CrossingAnswers answers;
+};
+
+// The puzzle input, solved the first time either part asks
+const WireSolver &puzzle_solver()
+{
+    static const WireSolver solver(kInput);
+    return solver;
+}
+
+// Coords inside a bounding box as single 64 bit keys that sort the same way
+// the pairs do, x then y. Both are biased by the corner of the box, so keys
+// only have as many bits as the box needs and a radix sort skips the rest.
+class CoordPacking
+{
+public:
+    // The box around both wires, so their keys can be compared
+    CoordPacking(const Wire &first, const Wire &second)
+    {
+        int max_x{std::numeric_limits<int>::min()};
+        int max_y{std::numeric_limits<int>::min()};
+        for (const Wire *wire : {&first, &second})
+        {
+            for (const Coord &coord : *wire)
+            {
+                min_x = std::min(min_x, coord.first);
+                max_x = std::max(max_x, coord.first);
+                min_y = std::min(min_y, coord.second);
+                max_y = std::max(max_y, coord.second);
+            }
+        }
+        height = (max_y >= min_y) ? uint64_t(long(max_y) - min_y) + 1 : 1;
+    };
+
+    uint64_t key(const Coord &coord) const
+    {
+        return uint64_t(long(coord.first) - min_x) * height + uint64_t(long(coord.second) - min_y);
+    };
+
+    Coord coord(uint64_t key) const
+    {
+        return {int(min_x + long(key / height)), int(min_y + long(key % height))};
+    };
+
+    std::vector<uint64_t> keys(const Wire &wire) const
+    {
+        std::vector<uint64_t> keys(wire.size());
+        for (size_t i = 0; i < wire.size(); i++)
+        {
+            keys[i] = key(wire[i]);
+        }
+        return keys;
+    };
+
+private:
+    int min_x{std::numeric_limits<int>::max()};
+    int min_y{std::numeric_limits<int>::max()};
+    uint64_t height;
+};
+
+// LSD radix sort 11 bits at a time. Digits every key shares, like the high
+// bits of packed coords, are skipped. Large inputs are split into one chunk
+// per thread: each thread counts its chunk, and the counts give every thread
+// its own place in each bucket to scatter into.
+void radix_sort(std::vector<uint64_t> &keys, unsigned threads = std::thread::hardware_concurrency())
+{
+    const int kBits{11};
+    const int kDigits{(64 + kBits - 1) / kBits};
+    const uint64_t kMask{(1u << kBits) - 1};
+    typedef std::array<size_t, 1 << 11> Counts;
+    const size_t n = keys.size();
+    threads = std::max(1u, std::min<unsigned>(threads, n / (1 << 16)));
+
+    auto each_chunk = [n, threads](auto body) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+        {
+            workers.emplace_back(body, t, n * t / threads, n * (t + 1) / threads);
+        }
+        body(0, 0, n / threads);
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    };
+
+    std::vector<Counts> totals(kDigits, Counts{});
+    for (uint64_t key : keys)
+    {
+        for (int digit = 0; digit < kDigits; digit++)
         {
-            sum += std::distance(first.begin(), iter);
+            totals[digit][(key >> (kBits * digit)) & kMask]++;
         }
-        iter = std::find(second.begin(), second.end(), intersection);
-        if (iter != second.end())
+    }
+
+    std::vector<uint64_t> buffer(n);
+    uint64_t *source = keys.data();
+    uint64_t *target = buffer.data();
+    std::vector<Counts> offsets(threads);
+    for (int digit = 0; digit < kDigits; digit++)
+    {
+        const int shift = kBits * digit;
+        if (std::find(totals[digit].begin(), totals[digit].end(), n) != totals[digit].end())
         {
-            sum += std::distance(second.begin(), iter);
+            continue;
         }
 
-        if (sum < min)
+        each_chunk([&](unsigned t, size_t begin, size_t end) {
+            offsets[t].fill(0);
+            for (size_t i = begin; i < end; i++)
+            {
+                offsets[t][(source[i] >> shift) & kMask]++;
+            }
+        });
+
+        // Buckets in order, and within each bucket the threads in order
+        size_t next{0};
+        for (size_t bucket = 0; bucket <= kMask; bucket++)
         {
-            min = sum;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                size_t count = offsets[t][bucket];
+                offsets[t][bucket] = next;
+                next += count;
+            }
         }
+
+        each_chunk([&](unsigned t, size_t begin, size_t end) {
+            Counts &offset = offsets[t];
+            for (size_t i = begin; i < end; i++)
+            {
+                target[offset[(source[i] >> shift) & kMask]++] = source[i];
+            }
+        });
+        std::swap(source, target);
+    }
+
+    if (source != keys.data())
+    {
+        keys.swap(buffer);
     }
+}
+
+// Keys in both sorted lists, as many times as the fewer of them has it like
+// std::set_intersection. Every step writes and advances by comparison
+// results instead of branching on them, so there's nothing to mispredict.
+std::vector<uint64_t> merge_intersection(const std::vector<uint64_t> &first, const std::vector<uint64_t> &second)
+{
+    std::vector<uint64_t> common(std::min(first.size(), second.size()) + 1);
+    size_t i{0};
+    size_t j{0};
+    size_t k{0};
+    while (i < first.size() && j < second.size())
+    {
+        const uint64_t a = first[i];
+        const uint64_t b = second[j];
+        common[k] = a;
+        k += (a == b);
+        i += (a <= b);
+        j += (b <= a);
+    }
+    common.resize(k);
+    return common;
+}
+
+// Part 1 through packed keys: sort both wires by radix and merge
+long radix_closest(const Wire &first, const Wire &second, unsigned threads = std::thread::hardware_concurrency())
+{
+    const CoordPacking packing(first, second);
+    std::vector<uint64_t> first_keys = packing.keys(first);
+    std::vector<uint64_t> second_keys = packing.keys(second);
+    radix_sort(first_keys, threads);
+    radix_sort(second_keys, threads);
 
+    long min{std::numeric_limits<long>::max()};
+    for (uint64_t key : merge_intersection(first_keys, second_keys))
+    {
+        Coord coord = packing.coord(key);
+        if (coord != Coord{0, 0})
+        {
+            min = std::min(min, std::labs(coord.first) + std::labs(coord.second));
+        }
+    }
     return min;
 }
 
-int part1()
+// A straight run of a wire, from where the wire enters it to where it leaves.
+// steps is how far along the wire start is.
+struct Segment
 {
-    // parse the string for each line, build up an array of line segments
-    // for each line segment, find intersections, store
-    // find intersection with min x, min y
-    std::pair<std::string, std::string> inputs;
-    Wire first;
-    Wire second;
-    std::vector<Coord> intersections;
-    int distance;
+    Coord start;
+    Coord end;
+    long steps;
 
-    // R8,U5,L5,D3
-    // U7,R6,D4,L4 = distance 6
-    inputs = {"R8,U5,L5,D3",
-              "U7,R6,D4,L4"};
-    first = rasterize(tokenize(inputs.first));
-    second = rasterize(tokenize(inputs.second));
-    std::sort(first.begin(), first.end());
-    std::sort(second.begin(), second.end());
-    intersections.clear();
-    std::set_intersection(first.begin(), first.end(),
-                          second.begin(), second.end(),
-                          std::back_inserter(intersections));
-    distance = closest_intersection(intersections);
-    assert(6 == distance);
+    bool horizontal() const
+    {
+        return start.second == end.second;
+    };
 
-    // R75,D30,R83,U83,L12,D49,R71,U7,L72
-    // U62,R66,U55,R34,D71,R55,D58,R83 = distance 159
-    inputs = {"R75,D30,R83,U83,L12,D49,R71,U7,L72",
-              "U62,R66,U55,R34,D71,R55,D58,R83"};
-    first = rasterize(tokenize(inputs.first));
-    second = rasterize(tokenize(inputs.second));
-    std::sort(first.begin(), first.end());
-    std::sort(second.begin(), second.end());
-    intersections.clear();
-    std::set_intersection(first.begin(), first.end(),
-                          second.begin(), second.end(),
-                          std::back_inserter(intersections));
-    distance = closest_intersection(intersections);
-    assert(159 == distance);
+    // Steps along the wire to a point on the segment
+    long steps_to(const Coord &point) const
+    {
+        return steps + std::labs(long(point.first) - start.first) + std::labs(long(point.second) - start.second);
+    };
+};
 
-    // R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51
-    // U98,R91,D20,R16,D67,R40,U7,R15,U6,R7 = distance 135
-    inputs = {"R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51",
-              "U98,R91,D20,R16,D67,R40,U7,R15,U6,R7"};
-    first = rasterize(tokenize(inputs.first));
-    second = rasterize(tokenize(inputs.second));
-    std::sort(first.begin(), first.end());
-    std::sort(second.begin(), second.end());
-    intersections.clear();
-    std::set_intersection(first.begin(), first.end(),
-                          second.begin(), second.end(),
-                          std::back_inserter(intersections));
-    distance = closest_intersection(intersections);
-    assert(135 == distance);
+typedef std::vector<Segment> SegmentWire;
 
-    // Now for the real deal
-    inputs = kInput;
-    first = rasterize(tokenize(inputs.first));
-    second = rasterize(tokenize(inputs.second));
-    std::sort(first.begin(), first.end());
-    std::sort(second.begin(), second.end());
-    intersections.clear();
-    std::set_intersection(first.begin(), first.end(),
-                          second.begin(), second.end(),
-                          std::back_inserter(intersections));
-    distance = closest_intersection(intersections);
-    assert(896 == distance);
-    return distance;
+// A point both wires pass through, other than the origin
+struct Crossing
+{
+    Coord at;
+    long steps; // Combined steps both wires take to get there
+};
+
+// One segment per instruction instead of one coord per step, so a wire costs
+// the same however far it runs
+SegmentWire segmentize(const Tokens &instructions)
+{
+    SegmentWire segments;
+    Coord position{0, 0};
+    long steps{0};
+
+    for (std::string_view instruction : instructions)
+    {
+        const char direction = instruction.at(0);
+        const int num_steps = parse_int(instruction.substr(1));
+        Coord next = position;
+
+        if (direction == 'U')
+        {
+            next.second += num_steps;
+        }
+        else if (direction == 'D')
+        {
+            next.second -= num_steps;
+        }
+        else if (direction == 'L')
+        {
+            next.first -= num_steps;
+        }
+        else if (direction == 'R')
+        {
+            next.first += num_steps;
+        }
+
+        // Moves of nothing don't visit anything new
+        if (next == position)
+        {
+            continue;
+        }
+        segments.push_back({position, next, steps});
+        position = next;
+        steps += num_steps;
+    }
+
+    return segments;
 }
 
-int part2()
+void add_crossing(std::vector<Crossing> &crossings, const Coord &at, const Segment &a, const Segment &b)
 {
-    // parse the string for each line, build up an array of line segments
-    // for each line segment, find intersections, store
-    // find intersection with min x, min y
-    std::pair<std::string, std::string> inputs;
-    Wire first;
-    Wire first_sorted;
-    Wire second;
-    Wire second_sorted;
-    std::vector<Coord> intersections;
-    int steps;
+    if (at != Coord{0, 0})
+    {
+        crossings.push_back({at, a.steps_to(at) + b.steps_to(at)});
+    }
+}
 
-    // R8,U5,L5,D3
-    // U7,R6,D4,L4 = 30 steps
-    inputs = {"R8,U5,L5,D3",
-              "U7,R6,D4,L4"};
-    first = rasterize(tokenize(inputs.first));
-    first_sorted = first;
-    second = rasterize(tokenize(inputs.second));
-    second_sorted = second;
-    std::sort(first_sorted.begin(), first_sorted.end());
-    std::sort(second_sorted.begin(), second_sorted.end());
-    intersections.clear();
-    std::set_intersection(first_sorted.begin(), first_sorted.end(),
-                          second_sorted.begin(), second_sorted.end(),
-                          std::back_inserter(intersections));
-    steps = fewest_steps(intersections, first, second);
-    assert(30 == steps);
+// Crossings of one wire's horizontal segments with the other's verticals.
+// Sweeping left to right, a horizontal is live between its ends, kept by
+// its y, and each vertical picks up the live ones within its span.
+void perpendicular_crossings(const SegmentWire &across, const SegmentWire &upright, std::vector<Crossing> &crossings)
+{
+    enum Kind
+    {
+        Insert,
+        Query,
+        Remove
+    };
+    struct Event
+    {
+        int x;
+        Kind kind;
+        size_t index;
+    };
 
-    // R75,D30,R83,U83,L12,D49,R71,U7,L72
-    // U62,R66,U55,R34,D71,R55,D58,R83 = 610 steps
-    inputs = {"R75,D30,R83,U83,L12,D49,R71,U7,L72",
-              "U62,R66,U55,R34,D71,R55,D58,R83"};
-    first = rasterize(tokenize(inputs.first));
-    first_sorted = first;
-    second = rasterize(tokenize(inputs.second));
-    second_sorted = second;
-    std::sort(first_sorted.begin(), first_sorted.end());
-    std::sort(second_sorted.begin(), second_sorted.end());
-    intersections.clear();
-    std::set_intersection(first_sorted.begin(), first_sorted.end(),
-                          second_sorted.begin(), second_sorted.end(),
-                          std::back_inserter(intersections));
-    steps = fewest_steps(intersections, first, second);
-    assert(610 == steps);
+    std::vector<Event> events;
+    for (size_t i = 0; i < across.size(); i++)
+    {
+        if (across[i].horizontal())
+        {
+            events.push_back({std::min(across[i].start.first, across[i].end.first), Insert, i});
+            events.push_back({std::max(across[i].start.first, across[i].end.first), Remove, i});
+        }
+    }
+    for (size_t i = 0; i < upright.size(); i++)
+    {
+        if (!upright[i].horizontal())
+        {
+            events.push_back({upright[i].start.first, Query, i});
+        }
+    }
 
-    // R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51
-    // U98,R91,D20,R16,D67,R40,U7,R15,U6,R7 = 410 steps
-    inputs = {"R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51",
-              "U98,R91,D20,R16,D67,R40,U7,R15,U6,R7"};
-    first = rasterize(tokenize(inputs.first));
-    first_sorted = first;
-    second = rasterize(tokenize(inputs.second));
-    second_sorted = second;
-    std::sort(first_sorted.begin(), first_sorted.end());
-    std::sort(second_sorted.begin(), second_sorted.end());
-    intersections.clear();
-    std::set_intersection(first_sorted.begin(), first_sorted.end(),
-                          second_sorted.begin(), second_sorted.end(),
-                          std::back_inserter(intersections));
-    steps = fewest_steps(intersections, first, second);
-    assert(410 == steps);
+    // Ends are inclusive, so at the same x inserts go first and removes last
+    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+        return (a.x != b.x) ? (a.x < b.x) : (a.kind < b.kind);
+    });
 
-    // Now for the real deal
-    inputs = kInput;
-    first = rasterize(tokenize(inputs.first));
-    first_sorted = first;
-    second = rasterize(tokenize(inputs.second));
-    second_sorted = second;
-    std::sort(first_sorted.begin(), first_sorted.end());
-    std::sort(second_sorted.begin(), second_sorted.end());
-    intersections.clear();
-    std::set_intersection(first_sorted.begin(), first_sorted.end(),
-                          second_sorted.begin(), second_sorted.end(),
-                          std::back_inserter(intersections));
-    steps = fewest_steps(intersections, first, second);
-    assert(16524 == steps);
-    return steps;
+    typedef std::multimap<int, size_t> Live;
+    Live live;
+    std::vector<Live::iterator> handles(across.size());
+    for (const Event &event : events)
+    {
+        if (event.kind == Insert)
+        {
+            handles[event.index] = live.emplace(across[event.index].start.second, event.index);
+        }
+        else if (event.kind == Remove)
+        {
+            live.erase(handles[event.index]);
+        }
+        else
+        {
+            const Segment &vertical = upright[event.index];
+            const int low = std::min(vertical.start.second, vertical.end.second);
+            const int high = std::max(vertical.start.second, vertical.end.second);
+            for (Live::iterator iter = live.lower_bound(low); iter != live.end() && iter->first <= high; iter++)
+            {
+                add_crossing(crossings, {event.x, iter->first}, across[iter->second], vertical);
+            }
+        }
+    }
 }
 
-int main()
+// An overlap from low to high along a line both wires run on. Every point of
+// it is a crossing, but only its ends and the point nearest the origin can be
+// the closest or cheapest, as steps change linearly along it. Those stand in
+// for the rest, so a long overlap is still only a few crossings.
+void add_overlap(std::vector<Crossing> &crossings, bool horizontal, int line, int low, int high,
+                 const Segment &a, const Segment &b)
 {
-    std::cout << "Part1 distance: " << part1() << std::endl;
-    std::cout << "Part2 steps: " << part2() << std::endl;
-}
\ No newline at end of file
+    auto point = [horizontal, line](int along) -> Coord {
+        return horizontal ? Coord{along, line} : Coord{line, along};
+    };
+
+    for (int along : {low, high, std::clamp(0, low, high)})
+    {
+        add_crossing(crossings, point(along), a, b);
+    }
+    // Both wires leaving the origin together cross right next to it
+    if (line == 0 && low <= 0 && 0 <= high)
+    {
+        for (int along : {-1, 1})
+        {
+            if (low <= along && along <= high)
+            {
+                add_crossing(crossings, point(along), a, b);
+            }
+        }
+    }
+}
+
+// Overlaps between parallel segments on the same line
+void collinear_crossings(const SegmentWire &first, const SegmentWire &second, bool horizontal, std::vector<Crossing> &crossings)
+{
+    struct Span
+    {
+        int line;
+        int low;
+        int high;
+        int wire;
+        const Segment *segment;
+    };
+
+    std::vector<Span> spans;
+    for (int wire = 0; wire < 2; wire++)
+    {
+        for (const Segment &segment : (wire == 0) ? first : second)
+        {
+            if (segment.horizontal() != horizontal)
+            {
+                continue;
+            }
+            const int line = horizontal ? segment.start.second : segment.start.first;
+            const int a = horizontal ? segment.start.first : segment.start.second;
+            const int b = horizontal ? segment.end.first : segment.end.second;
+            spans.push_back({line, std::min(a, b), std::max(a, b), wire, &segment});
+        }
+    }
+    std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) {
+        return (a.line != b.line) ? (a.line < b.line) : (a.low < b.low);
+    });
+
+    std::vector<const Span *> live[2];
+    for (size_t i = 0; i < spans.size(); i++)
+    {
+        const Span &span = spans[i];
+        if (i == 0 || span.line != spans[i - 1].line)
+        {
+            live[0].clear();
+            live[1].clear();
+        }
+
+        // Spans of the other wire that started earlier and haven't ended
+        // yet all overlap this one
+        std::vector<const Span *> &others = live[1 - span.wire];
+        others.erase(std::remove_if(others.begin(), others.end(), [&span](const Span *other) {
+            return other->high < span.low;
+        }), others.end());
+
+        for (const Span *other : others)
+        {
+            add_overlap(crossings, horizontal, span.line, span.low, std::min(span.high, other->high),
+                        *span.segment, *other->segment);
+        }
+        live[span.wire].push_back(&span);
+    }
+}
+
+// Every crossing of two wires in O((n + k) log n) for n segments and k
+// crossings, however long the segments are
+std::vector<Crossing> sweep_crossings(const SegmentWire &first, const SegmentWire &second)
+{
+    std::vector<Crossing> crossings;
+    perpendicular_crossings(first, second, crossings);
+    perpendicular_crossings(second, first, crossings);
+    collinear_crossings(first, second, true, crossings);
+    collinear_crossings(first, second, false, crossings);
+    return crossings;
+}
+
+// Manhattan distance to the crossing nearest the origin
+long closest_crossing(const std::vector<Crossing> &crossings)
+{
+    long min{std::numeric_limits<long>::max()};
+    for (const Crossing &crossing : crossings)
+    {
+        min = std::min(min, std::labs(crossing.at.first) + std::labs(crossing.at.second));
+    }
+    return min;
+}
+
+long fewest_crossing_steps(const std::vector<Crossing> &crossings)
+{
+    long min{std::numeric_limits<long>::max()};
+    for (const Crossing &crossing : crossings)
+    {
+        min = std::min(min, crossing.steps);
+    }
+    return min;
+}
+
+// The smallest box holding every point a wire passes through
+std::pair<Coord, Coord> bounding_box(const SegmentWire &wire)
+{
+    Coord low{0, 0};
+    Coord high{0, 0};
+    for (const Segment &segment : wire)
+    {
+        low = {std::min(low.first, segment.end.first), std::min(low.second, segment.end.second)};
+        high = {std::max(high.first, segment.end.first), std::max(high.second, segment.end.second)};
+    }
+    return {low, high};
+}
+
+// One bit for every coord in a box, a row of 64 bit words for each y. Rows
+// are padded so the whole grid is a multiple of four words for the AVX2 scan.
+class Occupancy
+{
+public:
+    Occupancy(const Coord &low, const Coord &high)
+        : low(low), high(high),
+          stride((long(high.first) - low.first) / 64 + 1),
+          words((stride * (long(high.second) - low.second + 1) + 3) / 4 * 4, 0)
+    {
+    };
+
+    // Mark every coord of the wire inside the box
+    void add(const SegmentWire &wire)
+    {
+        for (const Segment &segment : wire)
+        {
+            const int x_low = std::max(std::min(segment.start.first, segment.end.first), low.first);
+            const int x_high = std::min(std::max(segment.start.first, segment.end.first), high.first);
+            const int y_low = std::max(std::min(segment.start.second, segment.end.second), low.second);
+            const int y_high = std::min(std::max(segment.start.second, segment.end.second), high.second);
+            if (x_low > x_high || y_low > y_high)
+            {
+                continue;
+            }
+
+            if (segment.horizontal())
+            {
+                set_run(y_low, x_low, x_high);
+            }
+            else
+            {
+                for (int y = y_low; y <= y_high; y++)
+                {
+                    set_run(y, x_low, x_low);
+                }
+            }
+        }
+    };
+
+    bool test(const Coord &coord) const
+    {
+        const size_t bit = bit_of(coord);
+        return (words[bit / 64] >> (bit % 64)) & 1;
+    };
+
+    void clear(const Coord &coord)
+    {
+        const size_t bit = bit_of(coord);
+        words[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+    };
+
+    Coord coord(size_t bit) const
+    {
+        return {int(low.first + long(bit % (stride * 64))), int(low.second + long(bit / (stride * 64)))};
+    };
+
+    const Coord low;
+    const Coord high;
+    const size_t stride; // Words per row
+    std::vector<uint64_t> words;
+
+private:
+    size_t bit_of(const Coord &coord) const
+    {
+        return (long(coord.second) - low.second) * stride * 64 + (long(coord.first) - low.first);
+    };
+
+    // Set x_low to x_high in row y a word at a time
+    void set_run(int y, int x_low, int x_high)
+    {
+        const size_t first = bit_of({x_low, y});
+        const size_t last = bit_of({x_high, y});
+        const uint64_t first_mask = ~uint64_t(0) << (first % 64);
+        const uint64_t last_mask = ~uint64_t(0) >> (63 - last % 64);
+        if (first / 64 == last / 64)
+        {
+            words[first / 64] |= first_mask & last_mask;
+            return;
+        }
+        words[first / 64] |= first_mask;
+        std::fill(words.begin() + first / 64 + 1, words.begin() + last / 64, ~uint64_t(0));
+        words[last / 64] |= last_mask;
+    };
+};
+
+// Append the bits of one word of an AND, counting them first so the list
+// only grows once
+inline void append_bits(std::vector<size_t> &bits, size_t word, uint64_t value)
+{
+    size_t n = bits.size();
+    bits.resize(n + __builtin_popcountll(value));
+    for (; value != 0; value &= value - 1)
+    {
+        bits[n++] = word * 64 + __builtin_ctzll(value);
+    }
+}
+
+// Every bit set in both grids of count words
+void and_scan_scalar(const uint64_t *first, const uint64_t *second, size_t count, std::vector<size_t> &bits)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (uint64_t value = first[i] & second[i])
+        {
+            append_bits(bits, i, value);
+        }
+    }
+}
+
+// Four words at a time, skipping blocks where the wires don't meet with a
+// single test, which is nearly all of them
+__attribute__((target("avx2")))
+void and_scan_avx2(const uint64_t *first, const uint64_t *second, size_t count, std::vector<size_t> &bits)
+{
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(second + i));
+        if (_mm256_testz_si256(a, b))
+        {
+            continue;
+        }
+
+        alignas(32) uint64_t values[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values), _mm256_and_si256(a, b));
+        for (size_t k = 0; k < 4; k++)
+        {
+            if (values[k] != 0)
+            {
+                append_bits(bits, i + k, values[k]);
+            }
+        }
+    }
+}
+
+// Crossings of two wires through occupancy grids over the box where their
+// bounding boxes overlap, in order of y then x
+std::vector<Coord> bitset_crossings(const SegmentWire &first, const SegmentWire &second)
+{
+    auto [first_low, first_high] = bounding_box(first);
+    auto [second_low, second_high] = bounding_box(second);
+    const Coord low{std::max(first_low.first, second_low.first), std::max(first_low.second, second_low.second)};
+    const Coord high{std::min(first_high.first, second_high.first), std::min(first_high.second, second_high.second)};
+
+    Occupancy first_bits(low, high);
+    Occupancy second_bits(low, high);
+    first_bits.add(first);
+    second_bits.add(second);
+    first_bits.clear({0, 0});
+
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    std::vector<size_t> bits;
+    (avx2 ? and_scan_avx2 : and_scan_scalar)(first_bits.words.data(), second_bits.words.data(), first_bits.words.size(), bits);
+
+    std::vector<Coord> crossings(bits.size());
+    std::transform(bits.begin(), bits.end(), crossings.begin(), [&first_bits](size_t bit) {
+        return first_bits.coord(bit);
+    });
+    return crossings;
+}
+
+// Steps to the first visit of each point, which must be on the wire. Each
+// segment finds the points on it by binary search, in points sorted by row
+// for horizontals and by column for verticals.
+std::vector<long> first_visit_steps(const SegmentWire &wire, const std::vector<Coord> &points)
+{
+    std::vector<long> steps(points.size(), std::numeric_limits<long>::max());
+    std::vector<size_t> by_row(points.size());
+    std::iota(by_row.begin(), by_row.end(), 0);
+    std::vector<size_t> by_column = by_row;
+    std::sort(by_row.begin(), by_row.end(), [&points](size_t a, size_t b) {
+        return std::make_pair(points[a].second, points[a].first) < std::make_pair(points[b].second, points[b].first);
+    });
+    std::sort(by_column.begin(), by_column.end(), [&points](size_t a, size_t b) {
+        return points[a] < points[b];
+    });
+
+    for (const Segment &segment : wire)
+    {
+        const bool horizontal = segment.horizontal();
+        const std::vector<size_t> &order = horizontal ? by_row : by_column;
+        // Points as (line, along) so both orders search the same way
+        auto key = [&points, horizontal](size_t i) -> std::pair<int, int> {
+            return horizontal ? std::make_pair(points[i].second, points[i].first) : points[i];
+        };
+        const int line = horizontal ? segment.start.second : segment.start.first;
+        const int a = horizontal ? segment.start.first : segment.start.second;
+        const int b = horizontal ? segment.end.first : segment.end.second;
+
+        auto iter = std::lower_bound(order.begin(), order.end(), std::make_pair(line, std::min(a, b)),
+                                     [&key](size_t i, const std::pair<int, int> &value) { return key(i) < value; });
+        for (; iter != order.end() && key(*iter) <= std::make_pair(line, std::max(a, b)); iter++)
+        {
+            steps[*iter] = std::min(steps[*iter], segment.steps_to(points[*iter]));
+        }
+    }
+
+    return steps;
+}
+
+// Both answers from the bitset crossings, only ever looking at the set bits
+CrossingAnswers bitset_answers(const SegmentWire &first, const SegmentWire &second)
+{
+    std::vector<Coord> crossings = bitset_crossings(first, second);
+    std::vector<long> first_steps = first_visit_steps(first, crossings);
+    std::vector<long> second_steps = first_visit_steps(second, crossings);
+
+    CrossingAnswers answers{std::numeric_limits<long>::max(), std::numeric_limits<long>::max()};
+    for (size_t i = 0; i < crossings.size(); i++)
+    {
+        answers.distance = std::min(answers.distance, std::labs(crossings[i].first) + std::labs(crossings[i].second));
+        answers.steps = std::min(answers.steps, first_steps[i] + second_steps[i]);
+    }
+    return answers;
+}
+
+// Largest overlap, in coords, bitsets are ever used for: 8MB a wire
+const double kBitsetArea{1 << 26};
+
+// Both answers through whichever engine suits the wires. Bitsets cost a pass
+// over their words however few crossings there are, while the sweep slows
+// down with every crossing. So bitsets win when the wires pack their shared
+// box densely, with more steps than there are words in it, and the sweep
+// wins on sparse wires like the puzzle's.
+CrossingAnswers wire_answers(const SegmentWire &first, const SegmentWire &second)
+{
+    auto [first_low, first_high] = bounding_box(first);
+    auto [second_low, second_high] = bounding_box(second);
+    const double width = double(std::min(first_high.first, second_high.first)) - std::max(first_low.first, second_low.first) + 1;
+    const double height = double(std::min(first_high.second, second_high.second)) - std::max(first_low.second, second_low.second) + 1;
+    const double steps = (first.empty() || second.empty()) ? 0 :
+        double(std::min(first.back().steps_to(first.back().end), second.back().steps_to(second.back().end)));
+
+    if (width * height <= kBitsetArea && width * height / 64 <= steps)
+    {
+        return bitset_answers(first, second);
+    }
+    std::vector<Crossing> crossings = sweep_crossings(first, second);
+    return {closest_crossing(crossings), fewest_crossing_steps(crossings)};
+}
+
+// Crossings between one segment of each wire
+void segment_pair_crossings(const Segment &a, const Segment &b, std::vector<Crossing> &crossings)
+{
+    if (a.horizontal() != b.horizontal())
+    {
+        const Segment &across = a.horizontal() ? a : b;
+        const Segment &upright = a.horizontal() ? b : a;
+        const int x = upright.start.first;
+        const int y = across.start.second;
+        if (std::min(across.start.first, across.end.first) <= x && x <= std::max(across.start.first, across.end.first) &&
+            std::min(upright.start.second, upright.end.second) <= y && y <= std::max(upright.start.second, upright.end.second))
+        {
+            add_crossing(crossings, {x, y}, a, b);
+        }
+        return;
+    }
+
+    const bool horizontal = a.horizontal();
+    const int line = horizontal ? a.start.second : a.start.first;
+    if (line != (horizontal ? b.start.second : b.start.first))
+    {
+        return;
+    }
+    auto along = [horizontal](const Segment &segment) -> std::pair<int, int> {
+        const int start = horizontal ? segment.start.first : segment.start.second;
+        const int end = horizontal ? segment.end.first : segment.end.second;
+        return std::minmax(start, end);
+    };
+    const int low = std::max(along(a).first, along(b).first);
+    const int high = std::min(along(a).second, along(b).second);
+    if (low <= high)
+    {
+        add_overlap(crossings, horizontal, line, low, high, a, b);
+    }
+}
+
+// Run body(begin, end, thread) over [0, count) on up to threads threads.
+// Threads claim a block at a time so uneven work balances out.
+template<typename Body>
+void parallel_blocks(size_t count, unsigned threads, size_t block, Body body)
+{
+    threads = std::max(1u, std::min<unsigned>(threads, (count + block - 1) / block));
+    std::atomic<size_t> next{0};
+    auto work = [&](unsigned thread) {
+        for (size_t begin = next.fetch_add(block); begin < count; begin = next.fetch_add(block))
+        {
+            body(begin, std::min(begin + block, count), thread);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers.emplace_back(work, i);
+    }
+    work(0);
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+// Any number of wires bucketed into a uniform grid over their bounding box.
+// Each cell lists the segments passing through it, so a query only looks at
+// segments near it and two wires are only compared where they share cells.
+// Cells are sized so most segments only touch a few of them.
+class WireGrid
+{
+public:
+    struct PairAnswers
+    {
+        size_t first;
+        size_t second;
+        CrossingAnswers answers;
+    };
+
+    // Build the cells in parallel: count the segments in each cell, lay the
+    // cells out end to end, then place every segment in its cells
+    WireGrid(const std::vector<SegmentWire> &wires, unsigned threads = std::thread::hardware_concurrency())
+    {
+        wire_begin.push_back(0);
+        for (size_t wire = 0; wire < wires.size(); wire++)
+        {
+            segments.insert(segments.end(), wires[wire].begin(), wires[wire].end());
+            owner.insert(owner.end(), wires[wire].size(), wire);
+            wire_begin.push_back(segments.size());
+        }
+
+        layout();
+
+        std::vector<std::atomic<uint32_t>> counts(cell_count());
+        parallel_blocks(segments.size(), threads, 4096, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                Span span = cells_of(segments[i]);
+                for (size_t k = 0; k < span.count; k++)
+                {
+                    counts[span.first + k * span.stride].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+
+        cell_begin.assign(cell_count() + 1, 0);
+        for (size_t cell = 0; cell < cell_count(); cell++)
+        {
+            cell_begin[cell + 1] = cell_begin[cell] + counts[cell].load(std::memory_order_relaxed);
+            counts[cell].store(0, std::memory_order_relaxed);
+        }
+
+        entries.resize(cell_begin.back());
+        parallel_blocks(segments.size(), threads, 4096, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++)
+            {
+                Span span = cells_of(segments[i]);
+                for (size_t k = 0; k < span.count; k++)
+                {
+                    size_t cell = span.first + k * span.stride;
+                    entries[cell_begin[cell] + counts[cell].fetch_add(1, std::memory_order_relaxed)] = i;
+                }
+            }
+        });
+
+        // Segments are numbered wire by wire, so sorted cells keep each
+        // wire's segments together
+        parallel_blocks(cell_count(), threads, 256, [&](size_t begin, size_t end, unsigned) {
+            for (size_t cell = begin; cell < end; cell++)
+            {
+                std::sort(entries.begin() + cell_begin[cell], entries.begin() + cell_begin[cell + 1]);
+            }
+        });
+
+        // And the cells each wire passes through, to compare wires with
+        wire_cells.resize(wires.size());
+        parallel_blocks(wires.size(), threads, 16, [&](size_t begin, size_t end, unsigned) {
+            for (size_t wire = begin; wire < end; wire++)
+            {
+                std::vector<size_t> &cells = wire_cells[wire];
+                for (size_t i = wire_begin[wire]; i < wire_begin[wire + 1]; i++)
+                {
+                    Span span = cells_of(segments[i]);
+                    for (size_t k = 0; k < span.count; k++)
+                    {
+                        cells.push_back(span.first + k * span.stride);
+                    }
+                }
+                std::sort(cells.begin(), cells.end());
+                cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+            }
+        });
+    };
+
+    size_t size() const
+    {
+        return wire_begin.size() - 1;
+    };
+
+    // Wires passing through any point of the box from low to high,
+    // in ascending order
+    std::vector<size_t> wires_in(const Coord &low, const Coord &high) const
+    {
+        std::vector<size_t> found;
+        if (segments.empty() || high.first < min_x || high.second < min_y ||
+            low.first > max_x || low.second > max_y)
+        {
+            return found;
+        }
+
+        const size_t first_col = column(std::max(low.first, min_x));
+        const size_t last_col = column(std::min(high.first, max_x));
+        for (size_t row = this->row(std::max(low.second, min_y)); row <= this->row(std::min(high.second, max_y)); row++)
+        {
+            for (size_t col = first_col; col <= last_col; col++)
+            {
+                const size_t cell = row * columns + col;
+                for (size_t i = cell_begin[cell]; i < cell_begin[cell + 1]; i++)
+                {
+                    const Segment &segment = segments[entries[i]];
+                    if (std::max(segment.start.first, segment.end.first) >= low.first &&
+                        std::min(segment.start.first, segment.end.first) <= high.first &&
+                        std::max(segment.start.second, segment.end.second) >= low.second &&
+                        std::min(segment.start.second, segment.end.second) <= high.second)
+                    {
+                        found.push_back(owner[entries[i]]);
+                    }
+                }
+            }
+        }
+
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        return found;
+    };
+
+    std::vector<size_t> wires_at(const Coord &point) const
+    {
+        return wires_in(point, point);
+    };
+
+    // Crossings of two wires, only comparing segments in the cells both of
+    // them pass through
+    std::vector<Crossing> crossings(size_t first, size_t second) const
+    {
+        std::vector<Crossing> found;
+        if (wire_cells[second].size() < wire_cells[first].size())
+        {
+            std::swap(first, second);
+        }
+
+        for (size_t cell : wire_cells[first])
+        {
+            auto [first_begin, first_end] = wire_range(cell, first);
+            auto [second_begin, second_end] = wire_range(cell, second);
+            for (const uint32_t *a = first_begin; a != first_end; a++)
+            {
+                for (const uint32_t *b = second_begin; b != second_end; b++)
+                {
+                    cell_crossings(cell, segments[*a], segments[*b], found);
+                }
+            }
+        }
+
+        return found;
+    };
+
+    CrossingAnswers answers(size_t first, size_t second) const
+    {
+        std::vector<Crossing> found = crossings(first, second);
+        return {closest_crossing(found), fewest_crossing_steps(found)};
+    };
+
+    // Answers for every pair of wires that cross, ordered by pair. Threads
+    // take cells in blocks and keep their own results until the end.
+    std::vector<PairAnswers> all_pairs(unsigned threads = std::thread::hardware_concurrency()) const
+    {
+        threads = std::max(1u, threads);
+        std::vector<std::unordered_map<uint64_t, CrossingAnswers>> partials(threads);
+        parallel_blocks(cell_count(), threads, 64, [&](size_t begin, size_t end, unsigned thread) {
+            std::unordered_map<uint64_t, CrossingAnswers> &partial = partials[thread];
+            std::vector<size_t> runs; // Where each wire's segments start in the cell
+            std::vector<Crossing> found;
+            for (size_t cell = begin; cell < end; cell++)
+            {
+                runs.clear();
+                for (size_t i = cell_begin[cell]; i < cell_begin[cell + 1]; i++)
+                {
+                    if (i == cell_begin[cell] || owner[entries[i]] != owner[entries[i - 1]])
+                    {
+                        runs.push_back(i);
+                    }
+                }
+                runs.push_back(cell_begin[cell + 1]);
+
+                // Every pair of wires in the cell, keeping the best of their
+                // crossings here before touching the results once
+                for (size_t r = 0; r + 1 < runs.size(); r++)
+                {
+                    for (size_t t = r + 1; t + 1 < runs.size(); t++)
+                    {
+                        found.clear();
+                        for (size_t i = runs[r]; i < runs[r + 1]; i++)
+                        {
+                            for (size_t j = runs[t]; j < runs[t + 1]; j++)
+                            {
+                                cell_crossings(cell, segments[entries[i]], segments[entries[j]], found);
+                            }
+                        }
+                        if (found.empty())
+                        {
+                            continue;
+                        }
+
+                        const uint64_t key = (uint64_t(owner[entries[runs[r]]]) << 32) | owner[entries[runs[t]]];
+                        CrossingAnswers best{closest_crossing(found), fewest_crossing_steps(found)};
+                        auto [slot, added] = partial.try_emplace(key, best);
+                        if (!added)
+                        {
+                            slot->second.distance = std::min(slot->second.distance, best.distance);
+                            slot->second.steps = std::min(slot->second.steps, best.steps);
+                        }
+                    }
+                }
+            }
+        });
+
+        std::unordered_map<uint64_t, CrossingAnswers> &merged = partials[0];
+        for (unsigned thread = 1; thread < threads; thread++)
+        {
+            for (const auto &[key, answers] : partials[thread])
+            {
+                auto [slot, added] = merged.try_emplace(key, answers);
+                if (!added)
+                {
+                    slot->second.distance = std::min(slot->second.distance, answers.distance);
+                    slot->second.steps = std::min(slot->second.steps, answers.steps);
+                }
+            }
+        }
+
+        std::vector<PairAnswers> pairs;
+        for (const auto &[key, answers] : merged)
+        {
+            pairs.push_back({size_t(key >> 32), size_t(key & 0xFFFFFFFF), answers});
+        }
+        std::sort(pairs.begin(), pairs.end(), [](const PairAnswers &a, const PairAnswers &b) {
+            return (a.first != b.first) ? (a.first < b.first) : (a.second < b.second);
+        });
+        return pairs;
+    };
+
+private:
+    // Cells a segment passes through, a run along its row or column
+    struct Span
+    {
+        size_t first;
+        size_t count;
+        size_t stride;
+    };
+
+    // Bounding box of every segment, and cells no smaller than a quarter of
+    // the average segment, or so many that there are more than four per
+    // segment
+    void layout()
+    {
+        min_x = min_y = std::numeric_limits<int>::max();
+        max_x = max_y = std::numeric_limits<int>::min();
+        long length{0};
+        for (const Segment &segment : segments)
+        {
+            for (const Coord &end : {segment.start, segment.end})
+            {
+                min_x = std::min(min_x, end.first);
+                max_x = std::max(max_x, end.first);
+                min_y = std::min(min_y, end.second);
+                max_y = std::max(max_y, end.second);
+            }
+            length += std::labs(long(segment.end.first) - segment.start.first) +
+                      std::labs(long(segment.end.second) - segment.start.second);
+        }
+        if (segments.empty())
+        {
+            min_x = max_x = min_y = max_y = 0;
+        }
+
+        const long width = long(max_x) - min_x + 1;
+        const long height = long(max_y) - min_y + 1;
+        const double area = double(width) * double(height);
+        cell_size = std::max<long>(1, length / std::max<long>(1, 4 * segments.size()));
+        cell_size = std::max<long>(cell_size, std::ceil(std::sqrt(area / std::max<size_t>(1, 4 * segments.size()))));
+        columns = (width + cell_size - 1) / cell_size;
+        rows = (height + cell_size - 1) / cell_size;
+    };
+
+    size_t cell_count() const
+    {
+        return columns * rows;
+    };
+
+    size_t column(int x) const
+    {
+        return (long(x) - min_x) / cell_size;
+    };
+
+    size_t row(int y) const
+    {
+        return (long(y) - min_y) / cell_size;
+    };
+
+    Span cells_of(const Segment &segment) const
+    {
+        const size_t first_col = column(std::min(segment.start.first, segment.end.first));
+        const size_t last_col = column(std::max(segment.start.first, segment.end.first));
+        const size_t first_row = row(std::min(segment.start.second, segment.end.second));
+        const size_t last_row = row(std::max(segment.start.second, segment.end.second));
+        if (segment.horizontal())
+        {
+            return {first_row * columns + first_col, last_col - first_col + 1, 1};
+        }
+        return {first_row * columns + first_col, last_row - first_row + 1, columns};
+    };
+
+    // A wire's segments within a cell
+    std::pair<const uint32_t *, const uint32_t *> wire_range(size_t cell, size_t wire) const
+    {
+        const uint32_t *begin = entries.data() + cell_begin[cell];
+        const uint32_t *end = entries.data() + cell_begin[cell + 1];
+        return {std::lower_bound(begin, end, wire_begin[wire]), std::lower_bound(begin, end, wire_begin[wire + 1])};
+    };
+
+    // Crossings of two segments that lie in cell. A crossing is in exactly
+    // one cell, so pairs that share several cells don't report it twice.
+    void cell_crossings(size_t cell, const Segment &a, const Segment &b, std::vector<Crossing> &found) const
+    {
+        // Most segments sharing a cell don't touch, which their boxes show
+        if (std::max(a.start.first, a.end.first) < std::min(b.start.first, b.end.first) ||
+            std::max(b.start.first, b.end.first) < std::min(a.start.first, a.end.first) ||
+            std::max(a.start.second, a.end.second) < std::min(b.start.second, b.end.second) ||
+            std::max(b.start.second, b.end.second) < std::min(a.start.second, a.end.second))
+        {
+            return;
+        }
+
+        const size_t before = found.size();
+        segment_pair_crossings(a, b, found);
+        found.erase(std::remove_if(found.begin() + before, found.end(), [this, cell](const Crossing &crossing) {
+            return row(crossing.at.second) * columns + column(crossing.at.first) != cell;
+        }), found.end());
+    };
+
+    std::vector<Segment> segments; // Every wire's segments, wire by wire
+    std::vector<uint32_t> owner;   // Wire of each segment
+    std::vector<size_t> wire_begin;
+    std::vector<size_t> cell_begin;
+    std::vector<uint32_t> entries; // Segments in each cell, in order
+    std::vector<std::vector<size_t>> wire_cells;
+    int min_x, min_y, max_x, max_y;
+    long cell_size;
+    size_t columns;
+    size_t rows;
+};
+
+int part1()
+{
+    // R8,U5,L5,D3
+    // U7,R6,D4,L4 = distance 6
+    assert(6 == WireSolver({"R8,U5,L5,D3",
+                            "U7,R6,D4,L4"}).closest());
+
+    // R75,D30,R83,U83,L12,D49,R71,U7,L72
+    // U62,R66,U55,R34,D71,R55,D58,R83 = distance 159
+    assert(159 == WireSolver({"R75,D30,R83,U83,L12,D49,R71,U7,L72",
+                              "U62,R66,U55,R34,D71,R55,D58,R83"}).closest());
+
+    // R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51
+    // U98,R91,D20,R16,D67,R40,U7,R15,U6,R7 = distance 135
+    assert(135 == WireSolver({"R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51",
+                              "U98,R91,D20,R16,D67,R40,U7,R15,U6,R7"}).closest());
+
+    // Now for the real deal
+    int distance = puzzle_solver().closest();
+    assert(896 == distance);
+    return distance;
+}
+
+int part2()
+{
+    // R8,U5,L5,D3
+    // U7,R6,D4,L4 = 30 steps
+    assert(30 == WireSolver({"R8,U5,L5,D3",
+                             "U7,R6,D4,L4"}).fewest_steps());
+
+    // R75,D30,R83,U83,L12,D49,R71,U7,L72
+    // U62,R66,U55,R34,D71,R55,D58,R83 = 610 steps
+    assert(610 == WireSolver({"R75,D30,R83,U83,L12,D49,R71,U7,L72",
+                              "U62,R66,U55,R34,D71,R55,D58,R83"}).fewest_steps());
+
+    // R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51
+    // U98,R91,D20,R16,D67,R40,U7,R15,U6,R7 = 410 steps
+    assert(410 == WireSolver({"R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51",
+                              "U98,R91,D20,R16,D67,R40,U7,R15,U6,R7"}).fewest_steps());
+
+    // Now for the real deal, already solved by part 1
+    int steps = puzzle_solver().fewest_steps();
+    assert(16524 == steps);
+    return steps;
+}
+
+// The sweep finds the same answers as the rasterized wires, including on
+// wires that overlap along a line, and doesn't mind enormous moves
+void test_segments()
+{
+    const std::vector<std::pair<std::string, std::string>> examples{
+        {"R8,U5,L5,D3", "U7,R6,D4,L4"},
+        {"R75,D30,R83,U83,L12,D49,R71,U7,L72", "U62,R66,U55,R34,D71,R55,D58,R83"},
+        {"R98,U47,R26,D63,R33,U87,L62,D20,R33,U53,R51", "U98,R91,D20,R16,D67,R40,U7,R15,U6,R7"},
+        kInput};
+    const std::vector<std::pair<long, long>> answers{{6, 30}, {159, 610}, {135, 410}, {896, 16524}};
+    for (size_t i = 0; i < examples.size(); i++)
+    {
+        std::vector<Crossing> crossings = sweep_crossings(segmentize(tokenize(examples[i].first)),
+                                                          segmentize(tokenize(examples[i].second)));
+        assert(answers[i].first == closest_crossing(crossings));
+        assert(answers[i].second == fewest_crossing_steps(crossings));
+    }
+
+    // Random wires that double back on themselves and each other
+    std::mt19937 rng(3);
+    const char directions[] = {'U', 'D', 'L', 'R'};
+    for (int trial = 0; trial < 500; trial++)
+    {
+        std::pair<std::string, std::string> wires;
+        for (std::string *wire : {&wires.first, &wires.second})
+        {
+            for (int i = 0; i < 30; i++)
+            {
+                *wire += std::string(i ? "," : "") + directions[rng() % 4] + std::to_string(rng() % 8);
+            }
+        }
+
+        StepIndex first_index;
+        StepIndex second_index;
+        Wire first = rasterize(tokenize(wires.first), &first_index);
+        Wire second = rasterize(tokenize(wires.second), &second_index);
+        Wire first_sorted = first;
+        Wire second_sorted = second;
+        std::sort(first_sorted.begin(), first_sorted.end());
+        std::sort(second_sorted.begin(), second_sorted.end());
+        std::vector<Coord> intersections;
+        std::set_intersection(first_sorted.begin(), first_sorted.end(),
+                              second_sorted.begin(), second_sorted.end(),
+                              std::back_inserter(intersections));
+        intersections.erase(std::unique(intersections.begin(), intersections.end()), intersections.end());
+
+        long distance{std::numeric_limits<long>::max()};
+        for (const Coord &intersection : intersections)
+        {
+            if (intersection != Coord{0, 0})
+            {
+                distance = std::min(distance, long(abs(intersection.first) + abs(intersection.second)));
+            }
+        }
+        long steps = (distance == std::numeric_limits<long>::max()) ? distance : fewest_steps(intersections, first_index, second_index);
+
+        std::vector<Crossing> crossings = sweep_crossings(segmentize(tokenize(wires.first)),
+                                                          segmentize(tokenize(wires.second)));
+        assert(distance == closest_crossing(crossings));
+        assert(steps == fewest_crossing_steps(crossings));
+
+        CrossingAnswers answers = index_crossings(first_index, second);
+        assert(distance == answers.distance && steps == answers.steps);
+    }
+
+    // Runs of half a billion, overlapping along the top
+    std::vector<Crossing> crossings = sweep_crossings(segmentize(tokenize("R500000000,U500000000,L1000000000")),
+                                                      segmentize(tokenize("U500000000,R500000000,D1")));
+    assert(500000000 == closest_crossing(crossings));
+    assert(2000000000 == fewest_crossing_steps(crossings));
+}
+
+// The index keeps first visits through growing, and one pass along the
+// second wire gives both answers
+void test_step_index()
+{
+    StepIndex index;
+    for (int i = 0; i < 100000; i++)
+    {
+        index.visit({i % 1000 - 500, i / 1000 - 50}, i);
+        index.visit({i % 1000 - 500, i / 1000 - 50}, i + 1);
+    }
+    assert(100000 == index.size());
+    assert(0 == index.find({-500, -50}));
+    assert(99999 == index.find({499, 49}));
+    assert(-1 == index.find({500, 0}));
+    assert(-1 == index.find({0, 50}));
+
+    StepIndex first;
+    rasterize(tokenize(kInput.first), &first);
+    CrossingAnswers answers = index_crossings(first, rasterize(tokenize(kInput.second)));
+    assert(896 == answers.distance);
+    assert(16524 == answers.steps);
+}
+
+// Packed keys radix sort into the same order as sorted coords on any
+// number of threads, and the merge matches std::set_intersection
+void test_radix_sort()
+{
+    std::mt19937 rng(46);
+    for (size_t size : {size_t(0), size_t(1), size_t(1000), size_t(300000)})
+    {
+        Wire coords(size);
+        for (Coord &coord : coords)
+        {
+            // Mostly near the origin, sometimes anywhere
+            const int spread = (rng() % 8) ? 5000 : std::numeric_limits<int>::max();
+            coord = {int(rng() % spread) - spread / 2, int(rng() % spread) - spread / 2};
+        }
+        Wire sorted = coords;
+        std::sort(sorted.begin(), sorted.end());
+
+        const CoordPacking packing(coords, {});
+        for (unsigned threads : {1u, 4u})
+        {
+            std::vector<uint64_t> keys = packing.keys(coords);
+            radix_sort(keys, threads);
+            assert(keys.size() == sorted.size());
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                assert(sorted[i] == packing.coord(keys[i]));
+            }
+        }
+    }
+
+    for (int trial = 0; trial < 100; trial++)
+    {
+        std::vector<uint64_t> first(rng() % 200);
+        std::vector<uint64_t> second(rng() % 200);
+        for (uint64_t &key : first)
+        {
+            key = rng() % 50;
+        }
+        for (uint64_t &key : second)
+        {
+            key = rng() % 50;
+        }
+        std::sort(first.begin(), first.end());
+        std::sort(second.begin(), second.end());
+        std::vector<uint64_t> expected;
+        std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+        assert(expected == merge_intersection(first, second));
+    }
+
+    assert(6 == radix_closest(rasterize(tokenize("R8,U5,L5,D3")), rasterize(tokenize("U7,R6,D4,L4"))));
+    assert(896 == radix_closest(rasterize(tokenize(kInput.first)), rasterize(tokenize(kInput.second))));
+}
+
+// A random walk of moves instructions, each up to longest steps
+std::string random_wire(std::mt19937 &rng, int moves, int longest)
+{
+    const char directions[] = {'U', 'D', 'L', 'R'};
+    std::string wire;
+    for (int i = 0; i < moves; i++)
+    {
+        wire += std::string(i ? "," : "") + directions[rng() % 4] + std::to_string(rng() % (longest + 1));
+    }
+    return wire;
+}
+
+// The bitset engine agrees with the sweep, both scan kernels find the same
+// bits, and the automatic choice gives the same answers whichever it picks
+void test_bitset()
+{
+    std::mt19937 rng(47);
+    for (int trial = 0; trial < 300; trial++)
+    {
+        SegmentWire first = segmentize(tokenize(random_wire(rng, 40, (trial % 3) ? 20 : 300)));
+        SegmentWire second = segmentize(tokenize(random_wire(rng, 40, (trial % 5) ? 20 : 300)));
+        std::vector<Crossing> crossings = sweep_crossings(first, second);
+        CrossingAnswers answers = bitset_answers(first, second);
+        assert(closest_crossing(crossings) == answers.distance);
+        assert(fewest_crossing_steps(crossings) == answers.steps);
+    }
+
+    std::vector<uint64_t> first(4096);
+    std::vector<uint64_t> second(4096);
+    for (size_t i = 0; i < first.size(); i++)
+    {
+        first[i] = (rng() % 16) ? 0 : (uint64_t(rng()) << 32 | rng());
+        second[i] = (rng() % 2) ? 0 : (uint64_t(rng()) << 32 | rng());
+    }
+    std::vector<size_t> scalar;
+    and_scan_scalar(first.data(), second.data(), first.size(), scalar);
+    assert(!scalar.empty());
+    if (__builtin_cpu_supports("avx2"))
+    {
+        std::vector<size_t> avx2;
+        and_scan_avx2(first.data(), second.data(), first.size(), avx2);
+        assert(scalar == avx2);
+    }
+
+    SegmentWire puzzle_first = segmentize(tokenize(kInput.first));
+    SegmentWire puzzle_second = segmentize(tokenize(kInput.second));
+    CrossingAnswers answers = bitset_answers(puzzle_first, puzzle_second);
+    assert(896 == answers.distance && 16524 == answers.steps);
+    answers = wire_answers(puzzle_first, puzzle_second);
+    assert(896 == answers.distance && 16524 == answers.steps);
+
+    // Packed tight enough that bitsets get picked
+    for (int trial = 0; trial < 20; trial++)
+    {
+        SegmentWire first = segmentize(tokenize(random_wire(rng, 2000, 10)));
+        SegmentWire second = segmentize(tokenize(random_wire(rng, 2000, 10)));
+        std::vector<Crossing> crossings = sweep_crossings(first, second);
+        answers = wire_answers(first, second);
+        assert(closest_crossing(crossings) == answers.distance);
+        assert(fewest_crossing_steps(crossings) == answers.steps);
+    }
+
+    // Too big for bitsets, so this one is swept
+    answers = wire_answers(segmentize(tokenize("R100000,U100000,L100000")), segmentize(tokenize("U100000,R50000,D1")));
+    assert(100000 == answers.distance && 400000 == answers.steps);
+}
+
+// Every pair in the grid agrees with sweeping that pair alone, however many
+// threads built it, and box queries find the same wires as checking every
+// segment
+void test_wire_grid()
+{
+    WireGrid puzzle({segmentize(tokenize(kInput.first)), segmentize(tokenize(kInput.second))});
+    assert(896 == puzzle.answers(0, 1).distance);
+    assert(16524 == puzzle.answers(0, 1).steps);
+    assert(1 == puzzle.all_pairs().size());
+
+    std::mt19937 rng(45);
+    std::vector<SegmentWire> wires;
+    for (int i = 0; i < 40; i++)
+    {
+        wires.push_back(segmentize(tokenize(random_wire(rng, 40, (i % 4 == 0) ? 300 : 30))));
+    }
+
+    for (unsigned threads : {1u, 4u})
+    {
+        WireGrid grid(wires, threads);
+        assert(wires.size() == grid.size());
+
+        std::vector<WireGrid::PairAnswers> expected;
+        for (size_t a = 0; a < wires.size(); a++)
+        {
+            for (size_t b = a + 1; b < wires.size(); b++)
+            {
+                std::vector<Crossing> crossings = sweep_crossings(wires[a], wires[b]);
+                CrossingAnswers answers = grid.answers(a, b);
+                assert(closest_crossing(crossings) == answers.distance);
+                assert(fewest_crossing_steps(crossings) == answers.steps);
+                if (!crossings.empty())
+                {
+                    expected.push_back({a, b, answers});
+                }
+            }
+        }
+
+        std::vector<WireGrid::PairAnswers> pairs = grid.all_pairs(threads);
+        assert(expected.size() == pairs.size());
+        for (size_t i = 0; i < pairs.size(); i++)
+        {
+            assert(expected[i].first == pairs[i].first && expected[i].second == pairs[i].second);
+            assert(expected[i].answers.distance == pairs[i].answers.distance);
+            assert(expected[i].answers.steps == pairs[i].answers.steps);
+        }
+
+        for (int query = 0; query < 1000; query++)
+        {
+            Coord low{int(rng() % 400) - 200, int(rng() % 400) - 200};
+            Coord high = low;
+            if (query % 2)
+            {
+                high.first += rng() % 50;
+                high.second += rng() % 50;
+            }
+
+            std::vector<size_t> found;
+            for (size_t wire = 0; wire < wires.size(); wire++)
+            {
+                for (const Segment &segment : wires[wire])
+                {
+                    if (std::max(segment.start.first, segment.end.first) >= low.first &&
+                        std::min(segment.start.first, segment.end.first) <= high.first &&
+                        std::max(segment.start.second, segment.end.second) >= low.second &&
+                        std::min(segment.start.second, segment.end.second) <= high.second)
+                    {
+                        found.push_back(wire);
+                        break;
+                    }
+                }
+            }
+            assert(found == ((query % 2) ? grid.wires_in(low, high) : grid.wires_at(low)));
+        }
+    }
+}
+
+// Every move of a wire made factor times longer
+std::string scale_wire(const std::string &wire, int factor)
+{
+    std::string scaled;
+    for (std::string_view instruction : tokenize(wire))
+    {
+        scaled += std::string(scaled.empty() ? "" : ",") + instruction.at(0) +
+                  std::to_string(factor * parse_int(instruction.substr(1)));
+    }
+    return scaled;
+}
+
+// Closest crossing by rasterizing and sorting against the sweep, on the
+// puzzle input stretched out further and further
+void segment_benchmark()
+{
+    for (int factor : {1, 4, 16, 1000})
+    {
+        const std::string first = scale_wire(kInput.first, factor);
+        const std::string second = scale_wire(kInput.second, factor);
+        long expected = 896L * factor;
+
+        // Rasterizing the longest runs to billions of coords
+        if (factor <= 16)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Wire first_wire = rasterize(tokenize(first));
+            Wire second_wire = rasterize(tokenize(second));
+            std::sort(first_wire.begin(), first_wire.end());
+            std::sort(second_wire.begin(), second_wire.end());
+            std::vector<Coord> intersections;
+            std::set_intersection(first_wire.begin(), first_wire.end(),
+                                  second_wire.begin(), second_wire.end(),
+                                  std::back_inserter(intersections));
+            long distance = closest_intersection(intersections);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "raster x" << factor << ": " << elapsed.count() * 1e3 << " ms"
+                      << ((distance == expected) ? "" : " WRONG") << std::endl;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Crossing> crossings = sweep_crossings(segmentize(tokenize(first)), segmentize(tokenize(second)));
+        long distance = closest_crossing(crossings);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "sweep x" << factor << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((distance == expected) ? "" : " WRONG") << std::endl;
+    }
+}
+
+// Both answers from sorting and intersecting the rasterized wires, then
+// looking the steps up, against one pass through the index
+void index_benchmark()
+{
+    for (int factor : {1, 4, 16})
+    {
+        const std::string first_scaled = scale_wire(kInput.first, factor);
+        const std::string second_scaled = scale_wire(kInput.second, factor);
+        const Tokens first = tokenize(first_scaled);
+        const Tokens second = tokenize(second_scaled);
+
+        auto start = std::chrono::steady_clock::now();
+        StepIndex first_index;
+        StepIndex second_index;
+        Wire first_wire = rasterize(first, &first_index);
+        Wire second_wire = rasterize(second, &second_index);
+        std::sort(first_wire.begin(), first_wire.end());
+        std::sort(second_wire.begin(), second_wire.end());
+        std::vector<Coord> intersections;
+        std::set_intersection(first_wire.begin(), first_wire.end(),
+                              second_wire.begin(), second_wire.end(),
+                              std::back_inserter(intersections));
+        long steps = fewest_steps(intersections, first_index, second_index);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "sort and intersect x" << factor << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((steps == 16524L * factor) ? "" : " WRONG") << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        StepIndex index;
+        rasterize(first, &index);
+        CrossingAnswers answers = index_crossings(index, rasterize(second));
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "index pass x" << factor << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((answers.steps == 16524L * factor && answers.distance == 896L * factor) ? "" : " WRONG") << std::endl;
+    }
+}
+
+// Every pair of a board of wires swept one pair at a time against the grid,
+// then bigger boards through the grid on one thread and on all of them
+void grid_benchmark()
+{
+    std::mt19937 rng(45);
+    std::vector<SegmentWire> wires;
+    for (int i = 0; i < 1000; i++)
+    {
+        wires.push_back(segmentize(tokenize(random_wire(rng, 150, 200))));
+    }
+
+    std::vector<SegmentWire> board(wires.begin(), wires.begin() + 300);
+    auto start = std::chrono::steady_clock::now();
+    size_t crossing_pairs{0};
+    for (size_t a = 0; a < board.size(); a++)
+    {
+        for (size_t b = a + 1; b < board.size(); b++)
+        {
+            crossing_pairs += !sweep_crossings(board[a], board[b]).empty();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "pairwise sweep 300 wires: " << elapsed.count() * 1e3 << " ms" << std::endl;
+
+    for (size_t count : {size_t(300), size_t(1000)})
+    {
+        board.assign(wires.begin(), wires.begin() + count);
+        for (unsigned threads : {1u, std::thread::hardware_concurrency()})
+        {
+            start = std::chrono::steady_clock::now();
+            WireGrid grid(board, threads);
+            std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+            std::vector<WireGrid::PairAnswers> pairs = grid.all_pairs(threads);
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "grid " << count << " wires " << threads << " threads: " << built.count() * 1e3
+                      << " ms to build, " << elapsed.count() * 1e3 << " ms for all pairs"
+                      << ((count != 300 || pairs.size() == crossing_pairs) ? "" : " WRONG") << std::endl;
+        }
+    }
+
+    WireGrid grid(wires);
+    start = std::chrono::steady_clock::now();
+    size_t found{0};
+    for (int query = 0; query < 100000; query++)
+    {
+        found += grid.wires_at({int(rng() % 4000) - 2000, int(rng() % 4000) - 2000}).size();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "grid point queries: " << 100000 / elapsed.count() / 1e6 << " M/s, "
+              << found / 100000.0 << " wires each" << std::endl;
+}
+
+// Sorting coord pairs and std::set_intersection against packed keys, radix
+// sorted on one thread and on all of them, then merged
+void radix_benchmark()
+{
+    for (int factor : {1, 4, 16, 64})
+    {
+        const Wire first = rasterize(tokenize(scale_wire(kInput.first, factor)));
+        const Wire second = rasterize(tokenize(scale_wire(kInput.second, factor)));
+
+        auto start = std::chrono::steady_clock::now();
+        Wire first_sorted = first;
+        Wire second_sorted = second;
+        std::sort(first_sorted.begin(), first_sorted.end());
+        std::sort(second_sorted.begin(), second_sorted.end());
+        std::vector<Coord> intersections;
+        std::set_intersection(first_sorted.begin(), first_sorted.end(),
+                              second_sorted.begin(), second_sorted.end(),
+                              std::back_inserter(intersections));
+        long distance = closest_intersection(intersections);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "std::sort x" << factor << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((distance == 896L * factor) ? "" : " WRONG") << std::endl;
+
+        for (unsigned threads : {1u, std::thread::hardware_concurrency()})
+        {
+            start = std::chrono::steady_clock::now();
+            distance = radix_closest(first, second, threads);
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "radix x" << factor << " " << threads << " threads: " << elapsed.count() * 1e3 << " ms"
+                      << ((distance == 896L * factor) ? "" : " WRONG") << std::endl;
+        }
+    }
+}
+
+// The sweep against the bitsets and whichever one gets picked, on the
+// puzzle input and on long wires that wander around a small box
+void bitset_benchmark()
+{
+    std::mt19937 rng(47);
+    const std::vector<std::pair<std::string, std::pair<SegmentWire, SegmentWire>>> cases{
+        {"puzzle", {segmentize(tokenize(kInput.first)), segmentize(tokenize(kInput.second))}},
+        {"compact", {segmentize(tokenize(random_wire(rng, 20000, 40))), segmentize(tokenize(random_wire(rng, 20000, 40)))}}};
+
+    for (const auto &[name, wires] : cases)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Crossing> crossings = sweep_crossings(wires.first, wires.second);
+        CrossingAnswers swept{closest_crossing(crossings), fewest_crossing_steps(crossings)};
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "sweep " << name << ": " << elapsed.count() * 1e3 << " ms" << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        CrossingAnswers answers = bitset_answers(wires.first, wires.second);
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "bitset " << name << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((answers.distance == swept.distance && answers.steps == swept.steps) ? "" : " WRONG") << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        answers = wire_answers(wires.first, wires.second);
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "picked " << name << ": " << elapsed.count() * 1e3 << " ms"
+                  << ((answers.distance == swept.distance && answers.steps == swept.steps) ? "" : " WRONG") << std::endl;
+    }
+}
+
+// Both parts the way they used to run, each rasterizing, copying, sorting
+// and intersecting the input again, against one WireSolver
+void solver_benchmark()
+{
+    auto start = std::chrono::steady_clock::now();
+    long distance{0};
+    long steps{0};
+    for (int part = 1; part <= 2; part++)
+    {
+        StepIndex first_index;
+        StepIndex second_index;
+        Wire first = rasterize(tokenize(kInput.first), &first_index);
+        Wire second = rasterize(tokenize(kInput.second), &second_index);
+        Wire first_sorted = first;
+        Wire second_sorted = second;
+        std::sort(first_sorted.begin(), first_sorted.end());
+        std::sort(second_sorted.begin(), second_sorted.end());
+        std::vector<Coord> intersections;
+        std::set_intersection(first_sorted.begin(), first_sorted.end(),
+                              second_sorted.begin(), second_sorted.end(),
+                              std::back_inserter(intersections));
+        if (part == 1)
+        {
+            distance = closest_intersection(intersections);
+        }
+        else
+        {
+            steps = fewest_steps(intersections, first_index, second_index);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "separate parts: " << elapsed.count() * 1e3 << " ms"
+              << ((distance == 896 && steps == 16524) ? "" : " WRONG") << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    WireSolver solver(kInput);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "WireSolver: " << elapsed.count() * 1e3 << " ms"
+              << ((solver.closest() == 896 && solver.fewest_steps() == 16524) ? "" : " WRONG") << std::endl;
+}
+
+int main()
+{
+    test_segments();
+    test_step_index();
+    test_radix_sort();
+    test_bitset();
+    test_wire_grid();
+    std::cout << "Part1 distance: " << part1() << std::endl;
+    std::cout << "Part2 steps: " << part2() << std::endl;
+
+#ifdef BENCHMARK
+    segment_benchmark();
+    index_benchmark();
+    radix_benchmark();
+    bitset_benchmark();
+    solver_benchmark();
+    grid_benchmark();
+#endif
+}
@@ -3,33 +3,13 @@
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <chrono>
+#include <string>
 #include "day4.hpp"
-
-std::vector<std::string> tokenize(const std::string &input, const char &token = ',')
-{
-    std::vector<std::string> results;
-    std::string current_chunk;
-
-    // Iterate and tokenize the input string
-    for (const char &current_character : input)
-    {
-        if (current_character == token)
-        {
-            // We found the token, add the current chunk to our results
-            results.push_back(current_chunk);
-            current_chunk.clear();
-        }
-        else
-        {
-            // We have not yet found the token, store the current character
-            current_chunk += current_character;
-        }
-    }
-    // Don't forget to flush the current chunk into the results
-    results.push_back(current_chunk);
-
-    return results;
-}
+#include "../common/tokenize.hpp"
 
 bool rule_six_digit(const int &password)
 {
@@ -109,6 +89,138 @@ bool validate(const int &password, const bool &pairs_only = false)
             rule_never_decrease(password));
 }
 
+// Counts the passwords in a range without trying each number. Digits never
+// decrease, so a number is built left to right and all that matters about
+// the digits so far is the last one, how long its run is and whether an
+// earlier run already qualified. The table holds how many ways there are to
+// finish from each of those states, for every number of digits left, so a
+// range takes a pass over the digits of its ends. Works for any 64 bit range.
+class PasswordCounter
+{
+public:
+    explicit PasswordCounter(bool pairs_only = false)
+        : pairs_only(pairs_only)
+    {
+        for (int last = 0; last < 10; last++)
+        {
+            for (int run = 1; run <= kLongRun; run++)
+            {
+                for (int found = 0; found < 2; found++)
+                {
+                    table[0][last][run][found] = (found || qualifies(run)) ? 1 : 0;
+                }
+            }
+        }
+
+        for (int remaining = 1; remaining <= kMaxDigits; remaining++)
+        {
+            for (int last = 0; last < 10; last++)
+            {
+                for (int run = 1; run <= kLongRun; run++)
+                {
+                    for (int found = 0; found < 2; found++)
+                    {
+                        uint64_t ways{0};
+                        for (int next = last; next < 10; next++)
+                        {
+                            State state = step({last, run, bool(found)}, next);
+                            ways += finish(remaining - 1, state);
+                        }
+                        table[remaining][last][run][found] = ways;
+                    }
+                }
+            }
+        }
+    };
+
+    // Valid passwords from lo to hi inclusive
+    uint64_t count(uint64_t lo, uint64_t hi) const
+    {
+        if (lo > hi)
+        {
+            return 0;
+        }
+        return count_up_to(hi) - ((lo > 0) ? count_up_to(lo - 1) : 0);
+    };
+
+    // Valid passwords from 1 to n. Shorter numbers are counted whole, then
+    // numbers as long as n that match its first i digits and go below it at
+    // the next one, for each i.
+    uint64_t count_up_to(uint64_t n) const
+    {
+        int digits[kMaxDigits];
+        int length{0};
+        for (uint64_t rest = n; rest > 0; rest /= 10)
+        {
+            digits[length++] = rest % 10;
+        }
+        std::reverse(digits, digits + length);
+
+        uint64_t total{0};
+        for (int shorter = 1; shorter < length; shorter++)
+        {
+            for (int first = 1; first < 10; first++)
+            {
+                total += finish(shorter - 1, {first, 1, false});
+            }
+        }
+
+        State state{1, 0, false}; // No digits yet, the first can't be 0
+        for (int i = 0; i < length; i++)
+        {
+            for (int next = state.last; next < digits[i]; next++)
+            {
+                total += finish(length - 1 - i, (i == 0) ? State{next, 1, false} : step(state, next));
+            }
+            if (digits[i] < state.last)
+            {
+                // Every number with n's digits so far decreases
+                return total;
+            }
+            state = (i == 0) ? State{digits[i], 1, false} : step(state, digits[i]);
+        }
+
+        // And n itself
+        return total + finish(0, state);
+    };
+
+    // 20 digits covers every 64 bit number
+    static constexpr int kMaxDigits{20};
+
+private:
+    // Runs of three or more all count the same
+    static constexpr int kLongRun{3};
+
+    struct State
+    {
+        int last;
+        int run;
+        bool found;
+    };
+
+    bool qualifies(int run) const
+    {
+        return pairs_only ? (run == 2) : (run >= 2);
+    };
+
+    State step(const State &state, int next) const
+    {
+        if (next == state.last)
+        {
+            return {next, std::min(state.run + 1, kLongRun), state.found};
+        }
+        return {next, 1, state.found || qualifies(state.run)};
+    };
+
+    uint64_t finish(int remaining, const State &state) const
+    {
+        return table[remaining][state.last][state.run][state.found];
+    };
+
+    bool pairs_only;
+    uint64_t table[kMaxDigits + 1][10][kLongRun + 1][2]{};
+};
+
 int part1()
 {
     bool valid;
@@ -119,16 +231,9 @@ int part1()
     valid = validate(223450);
     assert(false == valid);
 
-    int num_valid{0};
-    std::vector<std::string> input = tokenize(kInput, '-');
-    int i = atoi((*input.begin()).data());
-    for (int i = atoi((*input.begin()).data()); i <= atoi((*(input.end() - 1)).data()); i++)
-    {
-        if (validate(i))
-        {
-            num_valid++;
-        }
-    }
+    // The range is all six digit numbers, so the counter needs no length rule
+    auto [low, high] = split_once(kInput, '-');
+    int num_valid = PasswordCounter(false).count(parse_int<uint64_t>(low), parse_int<uint64_t>(high));
 
     assert(2090 == num_valid);
 
@@ -148,24 +253,94 @@ int part2()
     valid = validate(111122, true);
     assert(true == valid);
 
-    int num_valid{0};
-    std::vector<std::string> input = tokenize(kInput, '-');
-    int i = atoi((*input.begin()).data());
-    for (int i = atoi((*input.begin()).data()); i <= atoi((*(input.end() - 1)).data()); i++)
+    // The range is all six digit numbers, so the counter needs no length rule
+    auto [low, high] = split_once(kInput, '-');
+    int num_valid = PasswordCounter(true).count(parse_int<uint64_t>(low), parse_int<uint64_t>(high));
+
+    assert(1419 == num_valid);
+
+    return num_valid;
+}
+
+// The counter agrees with checking every number, on six digit ranges
+// through validate and on every shorter number through the digits
+void test_counter()
+{
+    for (bool pairs_only : {false, true})
     {
-        if (validate(i, true))
+        PasswordCounter counter(pairs_only);
+
+        std::mt19937 rng(50);
+        for (int trial = 0; trial < 50; trial++)
         {
-            num_valid++;
+            uint64_t lo = 100000 + rng() % 900000;
+            uint64_t hi = std::min<uint64_t>(999999, lo + rng() % 20000);
+            uint64_t expected{0};
+            for (uint64_t i = lo; i <= hi; i++)
+            {
+                expected += validate(i, pairs_only);
+            }
+            assert(expected == counter.count(lo, hi));
         }
+
+        uint64_t expected{0};
+        for (uint64_t i = 1; i < 100000; i++)
+        {
+            std::string digits = std::to_string(i);
+            expected += std::is_sorted(digits.begin(), digits.end()) && rule_adjacent(i, pairs_only);
+            assert(expected == counter.count_up_to(i));
+        }
+        assert(0 == counter.count(0, 0));
+        assert(0 == counter.count(10, 1));
     }
 
-    assert(1419 == num_valid);
+    // With 18 digits every non-decreasing number has a repeat, as there are
+    // only 9 digits to use, so part 1 counts all of them: 26 choose 8
+    PasswordCounter counter;
+    assert(1562275 == counter.count(100000000000000000ULL, 999999999999999999ULL));
 
-    return num_valid;
+    // Up to the largest 64 bit number, 18446744073709551615, the 20 digit
+    // ones start 11 to 17 and the rest is any 18 digits from the second on
+    assert(2220055 == counter.count(10000000000000000000ULL, std::numeric_limits<uint64_t>::max()));
+}
+
+// Checking every number in the puzzle range against counting it, then
+// counting the biggest ranges there are
+void counter_benchmark()
+{
+    auto [low, high] = split_once(kInput, '-');
+    const uint64_t lo = parse_int<uint64_t>(low);
+    const uint64_t hi = parse_int<uint64_t>(high);
+
+    auto start = std::chrono::steady_clock::now();
+    int num_valid{0};
+    for (uint64_t i = lo; i <= hi; i++)
+    {
+        num_valid += validate(i, true);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "validate every number: " << elapsed.count() * 1e6 << " us"
+              << ((num_valid == 1419) ? "" : " WRONG") << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    uint64_t counted = PasswordCounter(true).count(lo, hi);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "counter: " << elapsed.count() * 1e6 << " us"
+              << ((counted == 1419) ? "" : " WRONG") << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    counted = PasswordCounter(true).count(123456789012345678ULL, 987654321098765432ULL);
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "counter 18 digits: " << elapsed.count() * 1e6 << " us, " << counted << " passwords" << std::endl;
 }
 
 int main()
 {
+    test_counter();
     std::cout << "Part 1: " << part1() << std::endl;
     std::cout << "Part 2: " << part2() << std::endl;
-}
\ No newline at end of file
+
+#ifdef BENCHMARK
+    counter_benchmark();
+#endif
+}
@@ -1,12 +1,16 @@
 #include <iostream>
 #include <array>
+#include <utility>
+#include <cstddef>
 #include <vector>
-#include <stack>
+#include <map>
 #include <limits>
 #include <cmath>
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include "day5.hpp"
+#include "../common/workloads.hpp"
 
 enum ParameterMode
 {
@@ -28,6 +32,88 @@ enum OpCode
     Hcf = 99
 };
 
+// Why a budgeted run stopped
+enum RunStatus
+{
+    Halted,   // Hit Hcf
+    Exhausted // Ran out of instructions
+};
+
+// A program specialized on its system ID. The ID is the only input, so the
+// whole program folds away into its final memory and diagnostic output.
+struct Residual
+{
+    std::vector<int> program;
+    int entry;
+    std::string output;
+    bool hcf;
+};
+
+// Number of parameters following an opcode
+constexpr int parameter_count(OpCode opcode)
+{
+    switch (opcode)
+    {
+        case OpCode::Add:
+        case OpCode::Mul:
+        case OpCode::Lt:
+        case OpCode::Eq:  return 3;
+        case OpCode::Jit:
+        case OpCode::Jif: return 2;
+        case OpCode::In:
+        case OpCode::Out: return 1;
+        default:          return 0;
+    }
+}
+
+class IntCode;
+typedef void (IntCode::*Handler)();
+
+// Everything decode() needs to know about one instruction word
+struct Decoded
+{
+    OpCode opcode;
+    std::array<ParameterMode, 3> modes;
+    Handler handler;
+};
+
+// Handlers are numbered opcode slot * 8 + mode1 + 2 * mode2 + 4 * mode3.
+// Slot 0 is for words that aren't legal instructions, and Hcf takes the slot
+// after Eq.
+static const int kModeCombinations{8};
+static const int kHandlerCount{10 * kModeCombinations};
+
+// The largest legal instruction word is 11199, Hcf with three immediate modes
+static const int kInstructionWords{11200};
+
+constexpr OpCode slot_opcode(int slot)
+{
+    return (slot == 9) ? OpCode::Hcf : static_cast<OpCode>(slot);
+}
+
+// Handler number of every legal instruction word, worked out at compile time
+constexpr std::array<unsigned short, kInstructionWords> make_decode_table()
+{
+    std::array<unsigned short, kInstructionWords> table{};
+    for (int word = 0; word < kInstructionWords; word++)
+    {
+        int code = word % 100;
+        int slot = (code >= OpCode::Add && code <= OpCode::Eq) ? code : (code == OpCode::Hcf) ? 9 : 0;
+        int mode1 = word / 100 % 10;
+        int mode2 = word / 1000 % 10;
+        int mode3 = word / 10000 % 10;
+
+        if (slot && mode1 <= Immediate && mode2 <= Immediate && mode3 <= Immediate)
+        {
+            table[word] = slot * kModeCombinations + mode1 + 2 * mode2 + 4 * mode3;
+        }
+    }
+
+    return table;
+}
+
+static constexpr std::array<unsigned short, kInstructionWords> kDecodeTable = make_decode_table();
+
 class IntCode
 {
 public:
@@ -50,33 +136,46 @@ public:
         pc = ram.begin();
     };
 
+    // Resume a specialized program where specialization stopped
+    IntCode(const Residual &residual) : IntCode(residual.program)
+    {
+        pc = ram.begin() + residual.entry;
+        output = residual.output;
+        hcf = residual.hcf;
+    };
+
     ~IntCode(){};
 
     // Infinite loop until cpu halts
     void run()
     {
-        while (!hcf)
+        run_for(std::numeric_limits<unsigned long>::max());
+    };
+
+    // Run at most budget instructions
+    RunStatus run_for(unsigned long budget)
+    {
+        unsigned long limit = retired + std::min(budget, std::numeric_limits<unsigned long>::max() - retired);
+
+        while (!hcf && retired < limit)
         {
             decode();
             execute();
+            retired++;
         }
+
+        return hcf ? Halted : Exhausted;
     };
 
-    // Decode the instruction at pc
-    // Sets opcode, and access flags
+    // Decode the instruction at pc through the decode table
+    // Sets opcode, parameter modes and the handler specialized for them
     void decode()
     {
-        // The last two digits of the number are the opcode
-        int code = *pc % 100;
-        opcode = static_cast<OpCode>(code);
-
-        // Everything else are the parameter modes
-        std::string mode = std::to_string(*pc / 100);
-        for (const char& c : mode)
-        {
-            if (c == '0') modes.push(ParameterMode::Position);
-            else if (c == '1') modes.push(ParameterMode::Immediate);
-        }
+        int word = *pc;
+        const Decoded &decoded = kDecoded[(word >= 0 && word < kInstructionWords) ? kDecodeTable[word] : 0];
+        opcode = decoded.opcode;
+        modes = decoded.modes;
+        handler = decoded.handler;
 
         // We've decoded the opcode and parameter modes, increment PC
         pc++;
@@ -84,25 +183,7 @@ public:
 
     void execute()
     {
-        switch(opcode)
-        {
-            case OpCode::Add: Add(); break;
-            case OpCode::Mul: Mul(); break;
-            case OpCode::In:  In();  break;
-            case OpCode::Out: Out(); break;
-            case OpCode::Jit: Jit(); break;
-            case OpCode::Jif: Jif(); break;
-            case OpCode::Lt:  Lt();  break;
-            case OpCode::Eq:  Eq();  break;
-            case OpCode::Hcf: Hcf(); break;
-        }
-
-        // Clear opcode and parameter modes
-        opcode = Nop;
-        while (!modes.empty())
-        {
-            modes.pop();
-        }
+        (this->*handler)();
     };
 
     void write(int addr, int data)
@@ -115,42 +196,46 @@ public:
         return ram[addr];
     };
 
-    int load(ParameterMode mode)
+    template <ParameterMode M>
+    int load()
     {
-        if (mode == ParameterMode::Immediate)
+        if constexpr (M == ParameterMode::Immediate)
         {
             return *pc++;
         }
-        else // if (mode == ParameterMode::Position)
+        else // if constexpr (M == ParameterMode::Position)
         {
             return read(*pc++);
         }
     }
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Add()
     {
         // Get parameter 1
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Get parameter 2
-        int param2 = load(get_mode());
+        int param2 = load<M2>();
 
         // Write the result and increment PC
         write(*pc++, param1 + param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Mul()
     {
         // Get parameter 1
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Get parameter 2
-        int param2 = load(get_mode());
+        int param2 = load<M2>();
 
         // Write the result
         write(*pc++, param1 * param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void In()
     {
         // Get input
@@ -160,25 +245,28 @@ public:
         write(*pc++, data);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Out()
     {
         // Load data to output
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Output
         output+= std::to_string(param1);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Hcf()
     {
         hcf = true;
         pc++;
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Jit()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
         
         if (param1)
         {
@@ -186,10 +274,11 @@ public:
         }
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Jif()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
         
         if (!param1)
         {
@@ -197,59 +286,215 @@ public:
         }
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Lt()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
 
-        if (param1 < param2)
-        {
-            write(*pc++, 1);
-        }
-        else
-        {
-            write(*pc++, 0);
-        }
+        write(*pc++, param1 < param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Eq()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
 
-        if (param1 == param2)
-        {
-            write(*pc++, 1);
-        }
-        else
-        {
-            write(*pc++, 0);
-        }
+        write(*pc++, param1 == param2);
     };
 
-    ParameterMode get_mode()
+    // Words that aren't legal instructions do nothing
+    void Ignore()
     {
-        ParameterMode result = ParameterMode::Position;
-        if (modes.size())
-        {
-            result = modes.top();
-            modes.pop();
-        }
+    };
+
+    // Pick the handler for an exact opcode and set of modes. Modes of
+    // parameters an opcode doesn't have are ignored, so they share a handler.
+    template <OpCode Op, ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    static constexpr Handler handler_for()
+    {
+        constexpr int n = parameter_count(Op);
+        constexpr ParameterMode P1 = (n > 0) ? M1 : Position;
+        constexpr ParameterMode P2 = (n > 1) ? M2 : Position;
+        constexpr ParameterMode P3 = (n > 2) ? M3 : Position;
+
+        if constexpr (Op == OpCode::Add) return &IntCode::Add<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Mul) return &IntCode::Mul<P1, P2, P3>;
+        else if constexpr (Op == OpCode::In)  return &IntCode::In<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Out) return &IntCode::Out<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jit) return &IntCode::Jit<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jif) return &IntCode::Jif<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Lt)  return &IntCode::Lt<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Eq)  return &IntCode::Eq<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Hcf) return &IntCode::Hcf<P1, P2, P3>;
+        else return &IntCode::Ignore;
+    };
+
+    template <std::size_t I>
+    static constexpr Decoded make_decoded()
+    {
+        constexpr OpCode op = slot_opcode(I / kModeCombinations);
+        constexpr ParameterMode m1 = static_cast<ParameterMode>(I % 2);
+        constexpr ParameterMode m2 = static_cast<ParameterMode>(I / 2 % 2);
+        constexpr ParameterMode m3 = static_cast<ParameterMode>(I / 4 % 2);
 
-        return result;
+        return Decoded{op, {m1, m2, m3}, handler_for<op, m1, m2, m3>()};
+    };
+
+    template <std::size_t... I>
+    static constexpr std::array<Decoded, sizeof...(I)> make_decoded(std::index_sequence<I...>)
+    {
+        return {{make_decoded<I>()...}};
     };
 
     // Members
 public:
     bool hcf{false}; // Flag to Halt Catch Fire
+    unsigned long retired{0}; // Instructions executed so far
     std::array<int, 1024>::iterator pc;
-    OpCode opcode;
-    std::stack<ParameterMode> modes;
+    OpCode opcode{Nop};
+    std::array<ParameterMode, 3> modes{};
+    Handler handler{&IntCode::Ignore};
+
+    // Every (opcode, mode1, mode2, mode3) the decode table can point at
+    static const std::array<Decoded, kHandlerCount> kDecoded;
     std::array<int, 1024> ram{0};
     std::string input;
     std::string output;
 };
 
+constexpr std::array<Decoded, kHandlerCount> IntCode::kDecoded = IntCode::make_decoded(std::make_index_sequence<kHandlerCount>{});
+
+// Run the program on the known system ID
+Residual specialize(const std::vector<int> &program, int system_id)
+{
+    IntCode computer(program);
+    computer.input = std::to_string(system_id);
+    computer.run();
+
+    // Trailing zeroes are implied by the empty ram
+    int entry = computer.pc - computer.ram.begin();
+    auto end = computer.ram.rbegin();
+    while (end != computer.ram.rend() - entry - 1 && *end == 0)
+    {
+        end++;
+    }
+
+    return Residual{std::vector<int>(computer.ram.begin(), end.base()), entry, computer.output, computer.hcf};
+}
+
+// Specializations are cached per (program, system ID)
+const Residual &specialized(const std::vector<int> &program, int system_id)
+{
+    static std::map<std::pair<std::vector<int>, int>, Residual> cache;
+
+    auto key = std::make_pair(program, system_id);
+    auto found = cache.find(key);
+    if (found == cache.end())
+    {
+        found = cache.emplace(key, specialize(program, system_id)).first;
+    }
+
+    return found->second;
+}
+
+// Evaluate a program on a fixed system ID using only constexpr operations on
+// a std::array, so fixed programs can be checked with static_assert. Returns
+// the final diagnostic code, or -1 if any test output before it was non-zero.
+template <std::size_t N>
+constexpr int diagnostic_code(std::array<int, N> ram, int system_id)
+{
+    std::size_t pc{0};
+    int code{0};
+    bool passed{true};
+
+    auto load = [&](ParameterMode mode) -> int {
+        int param = ram.at(pc++);
+        return (mode == ParameterMode::Immediate) ? param : ram.at(param);
+    };
+
+    auto store = [&](int data) {
+        ram.at(ram.at(pc++)) = data;
+    };
+
+    while (true)
+    {
+        int word = ram.at(pc++);
+        unsigned short index = (word >= 0 && word < kInstructionWords) ? kDecodeTable[word] : 0;
+        OpCode opcode = slot_opcode(index / kModeCombinations);
+        ParameterMode mode1 = static_cast<ParameterMode>(index % 2);
+        ParameterMode mode2 = static_cast<ParameterMode>(index / 2 % 2);
+
+        switch (opcode)
+        {
+            case OpCode::Add:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                store(param1 + param2);
+                break;
+            }
+            case OpCode::Mul:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                store(param1 * param2);
+                break;
+            }
+            case OpCode::In:
+                store(system_id);
+                break;
+            case OpCode::Out:
+                passed = passed && !code;
+                code = load(mode1);
+                break;
+            case OpCode::Jit:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                if (param1)
+                {
+                    pc = param2;
+                }
+                break;
+            }
+            case OpCode::Jif:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                if (!param1)
+                {
+                    pc = param2;
+                }
+                break;
+            }
+            case OpCode::Lt:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                store(param1 < param2);
+                break;
+            }
+            case OpCode::Eq:
+            {
+                int param1 = load(mode1);
+                int param2 = load(mode2);
+                store(param1 == param2);
+                break;
+            }
+            case OpCode::Hcf:
+                return passed ? code : -1;
+            default:
+                break;
+        }
+    }
+}
+
+// The puzzle answers only depend on constants, so regressions fail the build
+static_assert(11933517 == diagnostic_code(kInput, 1), "part 1 answer changed");
+static_assert(10428568 == diagnostic_code(kInput, 5), "part 2 answer changed");
+
 void test_all_opcodes()
 {
     std::vector<int> input {1,2,3,4,99};
@@ -277,7 +522,7 @@ void test_parameter_modes()
     IntCode computer(input);
 
     computer.decode();
-    std::stack<ParameterMode> expected(std::deque<ParameterMode>{Immediate, Position});
+    std::array<ParameterMode, 3> expected{Position, Immediate, Position};
     assert(computer.modes == expected);
 }
 
@@ -379,22 +624,87 @@ void test_hcf()
     computer.run();
 }
 
+void test_run_for()
+{
+    std::vector<int> input {1101, 1, 2, 5, 99, 0};
+    IntCode computer(input);
+
+    assert(Exhausted == computer.run_for(1));
+    assert(1 == computer.retired);
+    assert(computer.ram[5] == 3);
+
+    assert(Halted == computer.run_for(10));
+    assert(2 == computer.retired);
+}
+
+void test_specialize()
+{
+    std::vector<int> input {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
+
+    const Residual &residual = specialized(input, 8);
+    assert(residual.hcf);
+    assert(residual.output == "1");
+    assert(&residual == &specialized(input, 8));
+
+    // Nothing is left to run
+    IntCode computer(residual);
+    computer.run();
+    assert(computer.output == "1");
+}
+
+void test_diagnostic_code()
+{
+    // Outputs 1 if the input equals 8, 0 otherwise
+    constexpr std::array<int, 11> input {3, 9, 8, 9, 10, 9, 4, 9, 99, -1, 8};
+    static_assert(1 == diagnostic_code(input, 8), "equal to 8");
+    static_assert(0 == diagnostic_code(input, 7), "not equal to 8");
+
+    // A failing test before the diagnostic code is reported
+    constexpr std::array<int, 5> failed {104, 1, 104, 2, 99};
+    static_assert(-1 == diagnostic_code(failed, 1), "failed test");
+}
+
 void part1()
 {
-    IntCode computer(kInput);
-    computer.input = "1";
+    IntCode computer(specialized(std::vector<int>(kInput.begin(), kInput.end()), 1));
     computer.run();
     assert(computer.output == "00000000011933517");
 }
 
 void part2()
 {
-    IntCode computer(kInput);
-    computer.input = "5";
+    IntCode computer(specialized(std::vector<int>(kInput.begin(), kInput.end()), 5));
     computer.run();
     assert(computer.output == "10428568");
 }
 
+// Every generated workload that fits in 1024 words without a relative base.
+// Output is one concatenated string, so a single result is parsed back and
+// echoed digits are summed.
+void workload_benchmark()
+{
+    run_workloads("day5", workload_suite<int>(1024, false), [](const Workload<int> &workload) {
+        IntCode computer(workload.program);
+        if (!workload.input.empty())
+        {
+            computer.input = std::to_string(workload.input.front());
+        }
+        computer.run();
+
+        if (workload.input.empty())
+        {
+            return static_cast<int64_t>(std::stoll(computer.output));
+        }
+
+        int64_t sum{0};
+        for (char digit : computer.output)
+        {
+            sum += digit - '0';
+        }
+        return sum;
+    });
+}
+
 int main()
 {
     test_all_opcodes();
@@ -408,9 +718,16 @@ int main()
     test_lt();
     test_eq();
     test_hcf();
+    test_run_for();
+    test_specialize();
+    test_diagnostic_code();
     
     part1();
     part2();
 
+#ifdef BENCHMARK
+    workload_benchmark();
+#endif
+
     return 0;
 }
\ No newline at end of file
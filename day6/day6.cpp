@@ -2,40 +2,18 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <cassert>
 #include "day6.hpp"
+#include "../common/tokenize.hpp"
 
-typedef std::map<std::string, std::string> Orbits;
+// Names are views into the input, which has to outlive the map
+typedef std::map<std::string_view, std::string_view> Orbits;
 
-std::vector<std::string> tokenize(const std::string &input, const char &token = '\n')
+void process(Orbits &orbits, std::string_view input)
 {
-    std::vector<std::string> results;
-    std::string chunk;
-    for (const char &c : input)
-    {
-        if (c == token)
-        {
-            results.push_back(chunk);
-            chunk.clear();
-        }
-        else
-        {
-            chunk += c;
-        }
-    }
-
-    // Last step, add the remaining chunk to the list
-    results.push_back(chunk);
-
-    return results;
-}
-
-void process(Orbits &orbits, const std::string &input)
-{
-    size_t n = input.find(')');
-    std::string parent_name = input.substr(0, n);
-    std::string child_name = input.substr(n + 1);
+    auto [parent_name, child_name] = split_once(input, ')');
 
     orbits[child_name] = parent_name;
     if (orbits.find(parent_name) == orbits.end())
@@ -49,7 +27,7 @@ int count_orbits(const Orbits &orbits)
     int num_orbits{0};
     for (auto orbit : orbits)
     {
-        std::string parent = orbit.second;
+        std::string_view parent = orbit.second;
         while (parent != "")
         {
             num_orbits++;
@@ -63,7 +41,9 @@ int count_orbits(const Orbits &orbits)
 void test_tokenize()
 {
     std::string input{"AAA)BBB\nBBB)CCC\nCCC)DDD"};
-    std::vector<std::string> results = tokenize(input, '\n');
+    Tokens tokens = tokenize(input, '\n');
+    std::vector<std::string_view> results(tokens.begin(), tokens.end());
+    assert(results.size() == 3);
     assert(results[0] == "AAA)BBB");
     assert(results[1] == "BBB)CCC");
     assert(results[2] == "CCC)DDD");
@@ -89,10 +69,10 @@ D)I
 E)J
 J)K
 K)L)ORBITS";
-    auto orbit_strings = tokenize(input);
+    auto orbit_strings = tokenize(input, '\n');
     Orbits orbits;
 
-    for (auto orbit : orbit_strings)
+    for (std::string_view orbit : orbit_strings)
     {
         process(orbits, orbit);
     }
@@ -103,10 +83,10 @@ K)L)ORBITS";
 
 int part1()
 {
-    auto orbit_strings = tokenize(kInput);
+    auto orbit_strings = tokenize(kInput, '\n');
     Orbits orbits;
 
-    for (auto orbit : orbit_strings)
+    for (std::string_view orbit : orbit_strings)
     {
         process(orbits, orbit);
     }
@@ -118,16 +98,16 @@ int part1()
 
 int part2()
 {
-    auto orbit_strings = tokenize(kInput);
+    auto orbit_strings = tokenize(kInput, '\n');
     Orbits orbits;
 
-    for (auto orbit : orbit_strings)
+    for (std::string_view orbit : orbit_strings)
     {
         process(orbits, orbit);
     }
 
-    std::string parent = orbits["SAN"];
-    std::vector<std::string> santa_orbit_chain;
+    std::string_view parent = orbits["SAN"];
+    std::vector<std::string_view> santa_orbit_chain;
     while (parent != "")
     {
         santa_orbit_chain.push_back(parent);
@@ -136,7 +116,7 @@ int part2()
     std::reverse(santa_orbit_chain.begin(), santa_orbit_chain.end());
 
     parent = orbits["YOU"];
-    std::vector<std::string> you_orbit_chain;
+    std::vector<std::string_view> you_orbit_chain;
     while (parent != "")
     {
         you_orbit_chain.push_back(parent);
@@ -1,9 +1,15 @@
 #include "day7.hpp"
+#include "../common/fd_stream.hpp"
+#include "../common/workloads.hpp"
 #include <iostream>
 #include <vector>
 #include <array>
-#include <stack>
+#include <utility>
+#include <cstddef>
 #include <queue>
+#include <deque>
+#include <map>
+#include <limits>
 #include <cassert>
 #include <numeric>
 #include <algorithm>
@@ -28,6 +34,91 @@ enum OpCode
     Hcf = 99
 };
 
+// Why a budgeted run stopped
+enum RunStatus
+{
+    Halted,    // Hit Hcf
+    Yielded,   // Produced an output
+    Blocked,   // Waiting on input
+    Exhausted  // Ran out of instructions
+};
+
+// A program specialized on a prefix of known inputs. Everything that only
+// depends on those inputs has already run, so execution resumes at entry with
+// whatever output that prefix produced.
+struct Residual
+{
+    std::vector<int> program;
+    int entry;
+    std::queue<int> output;
+    bool hcf;
+};
+
+// Number of parameters following an opcode
+constexpr int parameter_count(OpCode opcode)
+{
+    switch (opcode)
+    {
+        case OpCode::Add:
+        case OpCode::Mul:
+        case OpCode::Lt:
+        case OpCode::Eq:  return 3;
+        case OpCode::Jit:
+        case OpCode::Jif: return 2;
+        case OpCode::In:
+        case OpCode::Out: return 1;
+        default:          return 0;
+    }
+}
+
+class IntCode;
+typedef void (IntCode::*Handler)();
+
+// Everything decode() needs to know about one instruction word
+struct Decoded
+{
+    OpCode opcode;
+    std::array<ParameterMode, 3> modes;
+    Handler handler;
+};
+
+// Handlers are numbered opcode slot * 8 + mode1 + 2 * mode2 + 4 * mode3.
+// Slot 0 is for words that aren't legal instructions, and Hcf takes the slot
+// after Eq.
+static const int kModeCombinations{8};
+static const int kHandlerCount{10 * kModeCombinations};
+
+// The largest legal instruction word is 11199, Hcf with three immediate modes
+static const int kInstructionWords{11200};
+
+constexpr OpCode slot_opcode(int slot)
+{
+    return (slot == 9) ? OpCode::Hcf : static_cast<OpCode>(slot);
+}
+
+// Handler number of every legal instruction word, worked out at compile time
+constexpr std::array<unsigned short, kInstructionWords> make_decode_table()
+{
+    std::array<unsigned short, kInstructionWords> table{};
+    for (int word = 0; word < kInstructionWords; word++)
+    {
+        int code = word % 100;
+        int slot = (code >= OpCode::Add && code <= OpCode::Eq) ? code : (code == OpCode::Hcf) ? 9 : 0;
+        int mode1 = word / 100 % 10;
+        int mode2 = word / 1000 % 10;
+        int mode3 = word / 10000 % 10;
+
+        if (slot && mode1 <= Immediate && mode2 <= Immediate && mode3 <= Immediate)
+        {
+            table[word] = slot * kModeCombinations + mode1 + 2 * mode2 + 4 * mode3;
+        }
+    }
+
+    return table;
+}
+
+static constexpr std::array<unsigned short, kInstructionWords> kDecodeTable = make_decode_table();
+
 class IntCode
 {
 public:
@@ -50,35 +141,57 @@ public:
         pc = ram.begin();
     };
 
+    // Resume a specialized program where the known inputs ran out
+    IntCode(const Residual &residual) : IntCode(residual.program)
+    {
+        pc = ram.begin() + residual.entry;
+        output = residual.output;
+        hcf = residual.hcf;
+    };
+
     ~IntCode(){};
 
     // Infinite loop until cpu halts
     void run()
     {
-        while (!hcf && !halt)
+        run_for(std::numeric_limits<unsigned long>::max());
+    };
+
+    // Run at most budget instructions, stopping early on output, on an In
+    // with no input waiting, or when the cpu halts
+    RunStatus run_for(unsigned long budget)
+    {
+        blocked = false;
+        unsigned long limit = retired + std::min(budget, std::numeric_limits<unsigned long>::max() - retired);
+
+        while (!hcf && !halt && !blocked && retired < limit)
         {
             decode();
             execute();
+            retired++;
+        }
+
+        RunStatus status = hcf ? Halted : halt ? Yielded : blocked ? Blocked : Exhausted;
+
+        // The In that blocked didn't retire
+        if (blocked)
+        {
+            retired--;
         }
 
         halt = false;
+        return status;
     };
 
-    // Decode the instruction at pc
-    // Sets opcode, and access flags
+    // Decode the instruction at pc through the decode table
+    // Sets opcode, parameter modes and the handler specialized for them
     void decode()
     {
-        // The last two digits of the number are the opcode
-        int code = *pc % 100;
-        opcode = static_cast<OpCode>(code);
-
-        // Everything else are the parameter modes
-        std::string mode = std::to_string(*pc / 100);
-        for (const char& c : mode)
-        {
-            if (c == '0') modes.push(ParameterMode::Position);
-            else if (c == '1') modes.push(ParameterMode::Immediate);
-        }
+        int word = *pc;
+        const Decoded &decoded = kDecoded[(word >= 0 && word < kInstructionWords) ? kDecodeTable[word] : 0];
+        opcode = decoded.opcode;
+        modes = decoded.modes;
+        handler = decoded.handler;
 
         // We've decoded the opcode and parameter modes, increment PC
         pc++;
@@ -86,28 +199,7 @@ public:
 
     void execute()
     {
-        switch(opcode)
-        {
-            case OpCode::Add: Add(); break;
-            case OpCode::Mul: Mul(); break;
-            case OpCode::In:  In();  break;
-            case OpCode::Out: Out(); break;
-            case OpCode::Jit: Jit(); break;
-            case OpCode::Jif: Jif(); break;
-            case OpCode::Lt:  Lt();  break;
-            case OpCode::Eq:  Eq();  break;
-            case OpCode::Hcf: Hcf(); break;
-            
-            case OpCode::Nop: break;
-            default: break;
-        }
-
-        // Clear opcode and parameter modes
-        opcode = Nop;
-        while (!modes.empty())
-        {
-            modes.pop();
-        }
+        (this->*handler)();
     };
 
     void write(int addr, int data)
@@ -120,69 +212,84 @@ public:
         return ram[addr];
     };
 
-    int load(ParameterMode mode)
+    template <ParameterMode M>
+    int load()
     {
-        if (mode == ParameterMode::Immediate)
+        if constexpr (M == ParameterMode::Immediate)
         {
             return *pc++;
         }
-        else // if (mode == ParameterMode::Position)
+        else // if constexpr (M == ParameterMode::Position)
         {
             return read(*pc++);
         }
     }
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Add()
     {
         // Get parameter 1
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Get parameter 2
-        int param2 = load(get_mode());
+        int param2 = load<M2>();
 
         // Write the result and increment PC
         write(*pc++, param1 + param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Mul()
     {
         // Get parameter 1
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Get parameter 2
-        int param2 = load(get_mode());
+        int param2 = load<M2>();
 
         // Write the result
         write(*pc++, param1 * param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void In()
     {
+        // Rewind so the In runs again once there's input
+        if (input.empty())
+        {
+            pc--;
+            blocked = true;
+            return;
+        }
+
         // Write input to ram
         write(*pc++, input.front());
         input.pop();
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Out()
     {
         // Load data to output
-        int param1 = load(get_mode());
+        int param1 = load<M1>();
 
         // Output
         output.push(param1);
         halt = true;
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Hcf()
     {
         hcf = true;
         pc++;
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Jit()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
         
         if (param1)
         {
@@ -190,10 +297,11 @@ public:
         }
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Jif()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
         
         if (!param1)
         {
@@ -201,80 +309,142 @@ public:
         }
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Lt()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
 
-        if (param1 < param2)
-        {
-            write(*pc++, 1);
-        }
-        else
-        {
-            write(*pc++, 0);
-        }
+        write(*pc++, param1 < param2);
     };
 
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
     void Eq()
     {
-        int param1 = load(get_mode());
-        int param2 = load(get_mode());
+        int param1 = load<M1>();
+        int param2 = load<M2>();
 
-        if (param1 == param2)
-        {
-            write(*pc++, 1);
-        }
-        else
-        {
-            write(*pc++, 0);
-        }
+        write(*pc++, param1 == param2);
     };
 
-    ParameterMode get_mode()
+    // Words that aren't legal instructions do nothing
+    void Ignore()
     {
-        ParameterMode result = ParameterMode::Position;
-        if (modes.size())
-        {
-            result = modes.top();
-            modes.pop();
-        }
+    };
 
-        return result;
+    // Pick the handler for an exact opcode and set of modes. Modes of
+    // parameters an opcode doesn't have are ignored, so they share a handler.
+    template <OpCode Op, ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    static constexpr Handler handler_for()
+    {
+        constexpr int n = parameter_count(Op);
+        constexpr ParameterMode P1 = (n > 0) ? M1 : Position;
+        constexpr ParameterMode P2 = (n > 1) ? M2 : Position;
+        constexpr ParameterMode P3 = (n > 2) ? M3 : Position;
+
+        if constexpr (Op == OpCode::Add) return &IntCode::Add<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Mul) return &IntCode::Mul<P1, P2, P3>;
+        else if constexpr (Op == OpCode::In)  return &IntCode::In<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Out) return &IntCode::Out<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jit) return &IntCode::Jit<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jif) return &IntCode::Jif<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Lt)  return &IntCode::Lt<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Eq)  return &IntCode::Eq<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Hcf) return &IntCode::Hcf<P1, P2, P3>;
+        else return &IntCode::Ignore;
+    };
+
+    template <std::size_t I>
+    static constexpr Decoded make_decoded()
+    {
+        constexpr OpCode op = slot_opcode(I / kModeCombinations);
+        constexpr ParameterMode m1 = static_cast<ParameterMode>(I % 2);
+        constexpr ParameterMode m2 = static_cast<ParameterMode>(I / 2 % 2);
+        constexpr ParameterMode m3 = static_cast<ParameterMode>(I / 4 % 2);
+
+        return Decoded{op, {m1, m2, m3}, handler_for<op, m1, m2, m3>()};
+    };
+
+    template <std::size_t... I>
+    static constexpr std::array<Decoded, sizeof...(I)> make_decoded(std::index_sequence<I...>)
+    {
+        return {{make_decoded<I>()...}};
     };
 
     // Members
 public:
     bool hcf{false}; // Flag to Halt Catch Fire
     bool halt{false};
+    bool blocked{false}; // Waiting on input
+    unsigned long retired{0}; // Instructions executed so far
     std::array<int, 1024>::iterator pc;
-    OpCode opcode;
-    std::stack<ParameterMode> modes;
+    OpCode opcode{Nop};
+    std::array<ParameterMode, 3> modes{};
+    Handler handler{&IntCode::Ignore};
+
+    // Every (opcode, mode1, mode2, mode3) the decode table can point at
+    static const std::array<Decoded, kHandlerCount> kDecoded;
     std::array<int, 1024> ram{0};
     std::queue<int> input;
     std::queue<int> output;
 };
 
+constexpr std::array<Decoded, kHandlerCount> IntCode::kDecoded = IntCode::make_decoded(std::make_index_sequence<kHandlerCount>{});
+
+// Run the program on the known inputs until it asks for one we don't have
+Residual specialize(const std::vector<int> &program, const std::vector<int> &known)
+{
+    IntCode computer(program);
+    for (int data : known)
+    {
+        computer.input.push(data);
+    }
+
+    while (!computer.hcf && !(*computer.pc % 100 == OpCode::In && computer.input.empty()))
+    {
+        computer.decode();
+        computer.execute();
+    }
+
+    // Trailing zeroes are implied by the empty ram
+    int entry = computer.pc - computer.ram.begin();
+    auto end = computer.ram.rbegin();
+    while (end != computer.ram.rend() - entry - 1 && *end == 0)
+    {
+        end++;
+    }
+
+    return Residual{std::vector<int>(computer.ram.begin(), end.base()), entry, computer.output, computer.hcf};
+}
+
+// Specializations are cached per (program, known inputs)
+const Residual &specialized(const std::vector<int> &program, const std::vector<int> &known)
+{
+    static std::map<std::pair<std::vector<int>, std::vector<int>>, Residual> cache;
+
+    auto key = std::make_pair(program, known);
+    auto found = cache.find(key);
+    if (found == cache.end())
+    {
+        found = cache.emplace(key, specialize(program, known)).first;
+    }
+
+    return found->second;
+}
+
 int run_amplifiers(const std::vector<int> &program, const std::vector<int> &phase)
 {
-    // Init amplifiers with program code
-    IntCode ampa(program),
-            ampb(program),
-            ampc(program),
-            ampd(program),
-            ampe(program);
-    
-    // Init amplifiers with phase sequence
-    ampa.input.push(phase.at(0));
-    ampb.input.push(phase.at(1));
-    ampc.input.push(phase.at(2));
-    ampd.input.push(phase.at(3));
-    ampe.input.push(phase.at(4));
+    // Init amplifiers with program code specialized on their phase setting
+    IntCode ampa(specialized(program, {phase.at(0)})),
+            ampb(specialized(program, {phase.at(1)})),
+            ampc(specialized(program, {phase.at(2)})),
+            ampd(specialized(program, {phase.at(3)})),
+            ampe(specialized(program, {phase.at(4)}));
 
     // Test if we enable the feedback loop
     bool enable_feedback = (*std::max_element(phase.begin(), phase.end()) > 4);
 
-    int possible_output;
+    int possible_output{0};
 
     // Run the sequence
     ampa.input.push(0);
@@ -307,6 +477,62 @@ int run_amplifiers(const std::vector<int> &program, const std::vector<int> &phas
     return possible_output;
 };
 
+// Same circuit as run_amplifiers, but each amplifier runs as a stream filter
+// on one event loop, wired to the next through a pipe
+int stream_amplifiers(const std::vector<int> &program, const std::vector<int> &phase)
+{
+    std::deque<IntCode> amps;
+    for (int setting : phase)
+    {
+        amps.emplace_back(specialized(program, {setting}));
+    }
+
+    bool enable_feedback = (*std::max_element(phase.begin(), phase.end()) > 4);
+
+    // Pipe i feeds amplifier i, the last one carries the signal out
+    std::vector<std::array<int, 2>> pipes(amps.size() + 1);
+    for (auto &ends : pipes)
+    {
+        if (pipe(ends.data()) != 0)
+        {
+            throw std::runtime_error("pipe failed");
+        }
+    }
+
+    int64_t start{0};
+    if (write(pipes.front()[1], &start, sizeof(start)) != sizeof(start))
+    {
+        throw std::runtime_error("write failed");
+    }
+
+    // With feedback the last amplifier writes back into the first pipe,
+    // which it then owns, otherwise nothing more goes in
+    int &last_out = enable_feedback ? pipes.front()[1] : pipes.back()[1];
+    close(enable_feedback ? pipes.back()[1] : pipes.front()[1]);
+
+    StreamLoop<IntCode> loop;
+    for (size_t i = 0; i < amps.size(); i++)
+    {
+        loop.attach(amps[i], pipes[i][0], (i + 1 < amps.size()) ? pipes[i + 1][1] : last_out, Framing::Binary);
+    }
+    loop.run();
+
+    // The signal is the last word the last amplifier wrote
+    int result = enable_feedback ? pipes.front()[0] : pipes.back()[0];
+    int64_t signal{0}, data;
+    while (read(result, &data, sizeof(data)) == sizeof(data))
+    {
+        signal = data;
+    }
+
+    for (auto &ends : pipes)
+    {
+        close(ends[0]);
+    }
+
+    return signal;
+}
+
 void part1_test1()
 {
     std::vector<int> input{3,15,3,16,1002,16,10,16,1,16,15,15,4,15,99,0,0};
@@ -334,6 +560,44 @@ void part1_test3()
     assert(signal == 65210);
 }
 
+void specialize_test1()
+{
+    std::vector<int> input{3,15,3,16,1002,16,10,16,1,16,15,15,4,15,99,0,0};
+
+    // The phase setting is stored and the program waits on the signal
+    const Residual &residual = specialized(input, {4});
+    assert(residual.entry == 2);
+    assert(residual.program.at(15) == 4);
+    assert(residual.output.empty());
+    assert(&residual == &specialized(input, {4}));
+
+    IntCode computer(residual);
+    computer.input.push(7);
+    computer.run();
+    assert(computer.output.front() == 74);
+}
+
+void run_for_test1()
+{
+    std::vector<int> input{3,15,3,16,1002,16,10,16,1,16,15,15,4,15,99,0,0};
+    IntCode computer(input);
+
+    assert(Blocked == computer.run_for(10));
+    assert(0 == computer.retired);
+
+    computer.input.push(4);
+    assert(Blocked == computer.run_for(10));
+    assert(1 == computer.retired);
+
+    computer.input.push(3);
+    assert(Exhausted == computer.run_for(2));
+    assert(3 == computer.retired);
+    assert(Yielded == computer.run_for(10));
+    assert(34 == computer.output.front());
+    assert(Halted == computer.run_for(10));
+    assert(6 == computer.retired);
+}
+
 int part1()
 {
     std::vector<int> phase{0, 1, 2, 3, 4};
@@ -351,6 +615,18 @@ int part1()
     return max_signal;
 }
 
+void stream_test1()
+{
+    std::vector<int> input{3,15,3,16,1002,16,10,16,1,16,15,15,4,15,99,0,0};
+    assert(43210 == stream_amplifiers(input, {4,3,2,1,0}));
+
+    input = {3,26,1001,26,-4,26,3,27,1002,27,2,27,1,27,26,27,4,27,1001,28,-1,28,1005,28,6,99,0,0,5};
+    assert(139629729 == stream_amplifiers(input, {9,8,7,6,5}));
+
+    assert(run_amplifiers(kInput, {1,0,4,3,2}) == stream_amplifiers(kInput, {1,0,4,3,2}));
+    assert(run_amplifiers(kInput, {9,7,8,5,6}) == stream_amplifiers(kInput, {9,7,8,5,6}));
+}
+
 void part2_test1()
 {
     std::vector<int> input{3,26,1001,26,-4,26,3,27,1002,27,2,27,1,27,26,27,4,27,1001,28,-1,28,1005,28,6,99,0,0,5};
@@ -386,16 +662,47 @@ int part2()
     return max_signal;
 }
 
+// Every generated workload that fits in 1024 words without a relative base
+void workload_benchmark()
+{
+    run_workloads("day7", workload_suite<int>(1024, false), [](const Workload<int> &workload) {
+        IntCode computer(workload.program);
+        for (int data : workload.input)
+        {
+            computer.input.push(data);
+        }
+
+        int64_t sum{0};
+        while (!computer.hcf && !computer.blocked)
+        {
+            computer.run();
+            while (!computer.output.empty())
+            {
+                sum += computer.output.front();
+                computer.output.pop();
+            }
+        }
+        return sum;
+    });
+}
+
 int main()
 {
     part1_test1();
     part1_test2();
     part1_test3();
+    specialize_test1();
+    run_for_test1();
     std::cout << "Part1: " << part1() << std::endl;
 
     part2_test1();
     part2_test2();
+    stream_test1();
     std::cout << "Part2: " << part2() << std::endl;
 
+#ifdef BENCHMARK
+    workload_benchmark();
+#endif
+
     return 0;
 }
\ No newline at end of file
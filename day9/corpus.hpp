@@ -0,0 +1,20 @@
+#include <vector>
+
+// Periodic programs for cycle detection. Each reads its iteration counts as
+// input and outputs a single value.
+
+// Add 3 to an accumulator N times, counting down to zero
+static const std::vector<long> kSpinAdd{3,100,1001,101,3,101,1001,100,-1,100,1005,100,2,4,101,99};
+
+// Step two counters until the first equals N, outputs 7 * N
+static const std::vector<long> kTwoCounters{3,100,1001,101,1,101,1001,102,7,102,8,101,100,103,1006,103,2,4,102,99};
+
+// Counters addressed through the relative base, outputs 5 * N
+static const std::vector<long> kRelativeCounters{3,100,109,200,21201,0,1,0,21201,1,5,1,20207,0,100,2,1205,2,4,204,1,99};
+
+// An inner loop of N inside an outer loop of M, outputs N * M
+static const std::vector<long> kNestedLoops{3,100,3,101,1101,0,0,102,1001,102,1,102,1001,103,1,103,8,102,100,104,1006,104,8,1001,101,-1,101,1005,101,4,4,103,99};
+
+// Sum of a countdown, the accumulator grows by a different amount every
+// period so it must never be fast-forwarded. Outputs N * (N - 1) / 2
+static const std::vector<long> kTriangle{3,100,1001,100,-1,100,1,101,100,101,1005,100,2,4,101,99};
@@ -1,343 +1,504 @@
 #include "day9.hpp"
+#include "corpus.hpp"
+#include "intcode.hpp"
+#include "thread_pool.hpp"
+#include "../common/fd_stream.hpp"
+#include "../common/workloads.hpp"
 #include <iostream>
 #include <vector>
-#include <stack>
-#include <queue>
-#include <array>
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
 
-enum ParameterMode
-{
-    Position,
-    Immediate,
-    Relative
-};
-
-enum OpCode
-{
-    Nop,
-    Add,
-    Mul,
-    In,
-    Out,
-    Jit,
-    Jif,
-    Lt,
-    Eq,
-    Rbo,
-    Hcf = 99
-};
-
-class IntCode
+void part1_test1()
 {
-public:
-    // Default constructor with empty ram
-    IntCode()
-    {
-        ram.reserve(2048);
-        std::fill_n(std::back_inserter(ram), 2048, 0);
-        pc = ram.begin();
-    };
-
-    // Initialize the ram of the CPU with a set of ints
-    IntCode(std::vector<long> input)
+    std::vector<long> input{109, 1, 204, -1, 1001, 100, 1, 100, 1008, 100, 16, 101, 1006, 101, 0, 99};
+    std::vector<long> results;
+    IntCode computer(input);
+    while (!computer.hcf)
     {
-        ram.reserve(2048);
-        std::fill_n(std::back_inserter(ram), 2048, 0);
-
-        auto i = ram.begin();
-        for (long data : input)
+        computer.run();
+        if (!computer.output.empty())
         {
-            *i = data;
-            i++;
+            results.push_back(computer.output.front());
+            computer.output.pop();
         }
+    }
 
-        pc = ram.begin();
-    };
-
-    //~IntCode(){};
+    assert(results == input);
+}
 
-    // Infinite loop until cpu halts
-    void run()
+void part1_test2()
+{
+    std::vector<long> input{1102, 34915192, 34915192, 7, 4, 7, 99, 0};
+    long result{0};
+    IntCode computer(input);
+    while (!computer.hcf)
     {
-        while (!hcf && !halt)
+        computer.run();
+        if (!computer.output.empty())
         {
-            decode();
-            execute();
+            result = computer.output.front();
+            computer.output.pop();
         }
+    }
 
-        halt = false;
-    };
+    assert(1219070632396864 == result);
+}
 
-    // Decode the instruction at pc
-    // Sets opcode, and access flags
-    void decode()
+void part1_test3()
+{
+    std::vector<long> input{104, 1125899906842624, 99};
+    long result{0};
+    IntCode computer(input);
+    while (!computer.hcf)
     {
-        // The last two digits of the number are the opcode
-        int code = *pc % 100;
-        opcode = static_cast<OpCode>(code);
-
-        // Everything else are the parameter modes
-        std::string mode = std::to_string(*pc / 100);
-        for (const char& c : mode)
+        computer.run();
+        if (!computer.output.empty())
         {
-            if (c == '0') modes.push(ParameterMode::Position);
-            else if (c == '1') modes.push(ParameterMode::Immediate);
-            else if (c == '2') modes.push(ParameterMode::Relative);
+            result = computer.output.front();
+            computer.output.pop();
         }
+    }
 
-        // We've decoded the opcode and parameter modes, increment PC
-        pc++;
-    };
+    assert(1125899906842624 == result);
+}
 
-    void execute()
-    {
-        switch(opcode)
-        {
-            case OpCode::Add: Add(); break;
-            case OpCode::Mul: Mul(); break;
-            case OpCode::In:  In();  break;
-            case OpCode::Out: Out(); break;
-            case OpCode::Jit: Jit(); break;
-            case OpCode::Jif: Jif(); break;
-            case OpCode::Lt:  Lt();  break;
-            case OpCode::Eq:  Eq();  break;
-            case OpCode::Rbo: Rbo(); break;
-            case OpCode::Hcf: Hcf(); break;
-            
-            case OpCode::Nop: break;
-            default: break;
-        }
+// Sum a countdown loop, once traced and once interpreted
+void trace_test1()
+{
+    std::vector<long> input{1001, 100, -1, 100, 1, 101, 100, 101, 1005, 100, 0, 4, 101, 99};
+    input.resize(102);
+    input.at(100) = 1000;
 
-        // Clear opcode and parameter modes
-        opcode = Nop;
-        while (!modes.empty())
-        {
-            modes.pop();
-        }
-    };
+    IntCode traced(input);
+    traced.run();
+    assert(!traced.traces.empty());
 
-    void write(int addr, long data)
-    {
-        ram.at(addr) = data;
-    };
+    IntCode interpreted(input);
+    interpreted.trace_threshold = 0;
+    interpreted.run();
+    assert(interpreted.traces.empty());
 
-    void write(ParameterMode mode, long data)
-    {
-        if (mode == ParameterMode::Relative)
-        {
-            write(relative_base + *pc++, data);
-        }
-        else
-        {
-            write(*pc++, data);
-        }
-    };
+    assert(499500 == traced.output.front());
+    assert(interpreted.output.front() == traced.output.front());
+}
 
-    long read(int addr)
-    {
-        return ram.at(addr);
-    };
+// A loop that bumps one of its own immediates every iteration
+void trace_test2()
+{
+    std::vector<long> input{1001, 100, -1, 100, 1101, 0, 0, 101, 1001, 5, 1, 5, 1005, 100, 0, 4, 101, 99};
+    input.resize(102);
+    input.at(100) = 1000;
 
-    long load(ParameterMode mode)
-    {
-        if (mode == ParameterMode::Immediate)
-        {
-            return *pc++;
-        }
-        else if (mode == ParameterMode::Relative)
-        {
-            return read(relative_base + *pc++);
-        }
-        else // if (mode == ParameterMode::Position)
-        {
-            return read(*pc++);
-        }
-    }
+    IntCode computer(input);
+    computer.run();
 
-    void Add()
-    {
-        // Get parameter 1
-        long param1 = load(get_mode());
+    assert(999 == computer.output.front());
 
-        // Get parameter 2
-        long param2 = load(get_mode());
+    // Recording it is tried a few times, then it's left to the interpreter
+    assert(computer.traces.empty());
+    assert(kMaxRetraces + 1 == computer.retraces[0]);
+}
 
-        // Write the result and increment PC
-        write(get_mode(), param1 + param2);
-    };
+// An outer loop that bumps the immediate of a traced inner loop, so only
+// that inner trace is retired each time
+void trace_test3()
+{
+    std::vector<long> input{1001, 100, -1, 100, 1101, 50, 0, 102, 1001, 101, 1, 101, 1001, 102, -1, 102, 1005, 102, 8,
+                            1001, 10, 1, 10, 1005, 100, 0, 4, 101, 99};
+    input.resize(103);
+    input.at(100) = 20;
 
-    void Mul()
-    {
-        // Get parameter 1
-        long param1 = load(get_mode());
+    IntCode traced(input);
+    traced.run();
 
-        // Get parameter 2
-        long param2 = load(get_mode());
+    IntCode interpreted(input);
+    interpreted.trace_threshold = 0;
+    interpreted.run();
 
-        // Write the result
-        write(get_mode(), param1 * param2);
-    };
+    assert(10500 == traced.output.front());
+    assert(interpreted.output.front() == traced.output.front());
+    assert(kMaxRetraces + 1 == traced.retraces[8]);
+}
 
-    void In()
-    {
-        // Write input to ram
-        long data = input.front();
-        input.pop_front();
+void run_for_test1()
+{
+    std::vector<long> input{1001, 100, -1, 100, 1, 101, 100, 101, 1005, 100, 0, 3, 102, 4, 101, 99};
+    input.resize(102);
+    input.at(100) = 1000;
 
-        write(get_mode(), data);
-    };
+    // Each countdown iteration is 3 instructions, traced or not
+    IntCode computer(input);
+    assert(Exhausted == computer.run_for(100));
+    assert(100 == computer.retired);
+    assert(Exhausted == computer.run_for(1000));
+    assert(1100 == computer.retired);
+    assert(Blocked == computer.run_for(5000));
+    assert(3000 == computer.retired);
+    assert(Blocked == computer.run_for(5000));
+    assert(3000 == computer.retired);
 
-    void Out()
-    {
-        // Load data to output
-        long param1 = load(get_mode());
+    computer.input.push_back(1);
+    assert(Yielded == computer.run_for(5000));
+    assert(499500 == computer.output.front());
+    assert(Halted == computer.run_for(5000));
+    assert(3003 == computer.retired);
+}
 
-        // Output
-        output.push(param1);
-        halt = true;
-    };
+// Suspend part 2 partway through and fan out two runs from the checkpoint
+void checkpoint_test1()
+{
+    char path[] = "/tmp/day9-checkpoint-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
 
-    void Hcf()
-    {
-        hcf = true;
-        pc++;
-    };
+    IntCode computer(kInput);
+    computer.input.push_back(2);
+    computer.input.push_back(7);
+    RunStatus status = computer.run_for(100000);
+    assert(Exhausted == status);
+    bool saved = save_checkpoint(computer, path);
+    assert(saved);
 
-    void Jit()
+    for (int i = 0; i < 2; i++)
     {
-        long param1 = load(get_mode());
-        long param2 = load(get_mode());
-        
-        if (param1)
+        IntCode resumed;
+        bool loaded = load_checkpoint(resumed, path);
+        assert(loaded);
+        assert(resumed.retired == 100000);
+        assert(resumed.relative_base == computer.relative_base);
+        assert(resumed.ram == computer.ram);
+        assert(resumed.input.size() == 1 && resumed.input.front() == 7);
+
+        while (!resumed.hcf)
         {
-            pc = (ram.begin() + param2);
+            resumed.run();
         }
-    };
+        assert(86025 == resumed.output.front());
+    }
 
-    void Jif()
+    // Loading keeps the caller's tier settings
+    IntCode tuned;
+    tuned.trace_threshold = 0;
+    tuned.fast_forward = true;
+    bool loaded = load_checkpoint(tuned, path);
+    assert(loaded);
+    assert(0 == tuned.trace_threshold);
+    assert(tuned.fast_forward);
+    assert(tuned.ram == computer.ram);
+
+    // A header whose counts would overflow the layout is rejected
+    fd = open(path, O_WRONLY);
+    uint64_t huge = std::numeric_limits<uint64_t>::max() / 4;
+    ssize_t written = pwrite(fd, &huge, sizeof(huge), offsetof(CheckpointHeader, input_count));
+    assert(sizeof(huge) == written);
+    close(fd);
+    IntCode corrupt;
+    bool rejected = !load_checkpoint(corrupt, path);
+    assert(rejected);
+
+    unlink(path);
+}
+
+// Run a program to completion on the given input and return its last output
+long run_program(const std::vector<long> &program, const std::vector<long> &input, bool fast_forward, unsigned long *skipped = nullptr)
+{
+    IntCode computer(program);
+    computer.fast_forward = fast_forward;
+    computer.input.assign(input.begin(), input.end());
+
+    long result{0};
+    while (!computer.hcf)
     {
-        long param1 = load(get_mode());
-        long param2 = load(get_mode());
-        
-        if (!param1)
+        computer.run();
+        if (!computer.output.empty())
         {
-            pc = (ram.begin() + param2);
+            result = computer.output.front();
+            computer.output.pop();
         }
-    };
+    }
 
-    void Lt()
+    if (skipped)
     {
-        long param1 = load(get_mode());
-        long param2 = load(get_mode());
+        *skipped = computer.periods_skipped;
+    }
 
-        if (param1 < param2)
-        {
-            write(get_mode(), 1);
-        }
-        else
-        {
-            write(get_mode(), 0);
-        }
-    };
+    return result;
+}
 
-    void Eq()
+void cycle_test1()
+{
+    unsigned long skipped;
+
+    assert(3000 == run_program(kSpinAdd, {1000}, false));
+    assert(3000 == run_program(kSpinAdd, {1000}, true, &skipped));
+    assert(skipped > 900);
+
+    assert(7000 == run_program(kTwoCounters, {1000}, false));
+    assert(7000 == run_program(kTwoCounters, {1000}, true, &skipped));
+    assert(skipped > 900);
+
+    assert(5000 == run_program(kRelativeCounters, {1000}, false));
+    assert(5000 == run_program(kRelativeCounters, {1000}, true, &skipped));
+    assert(skipped > 900);
+
+    assert(30000 == run_program(kNestedLoops, {1000, 30}, false));
+    assert(30000 == run_program(kNestedLoops, {1000, 30}, true, &skipped));
+    assert(skipped > 900 * 30);
+
+    assert(499500 == run_program(kTriangle, {1000}, false));
+    assert(499500 == run_program(kTriangle, {1000}, true, &skipped));
+    assert(0 == skipped);
+
+    // A loop that keeps failing to repeat is handed back to tracing
+    IntCode triangle(kTriangle);
+    triangle.fast_forward = true;
+    triangle.input.push_back(1000);
+    triangle.run();
+    assert(499500 == triangle.output.front());
+    assert(kMaxSampleMisses == triangle.sample_misses[2]);
+    assert(!triangle.traces.empty());
+
+    // Fast-forwarding never overruns a budget
+    IntCode computer(kSpinAdd);
+    computer.fast_forward = true;
+    computer.input.push_back(1000);
+    assert(Exhausted == computer.run_for(1000));
+    assert(1000 == computer.retired);
+    assert(computer.periods_skipped > 0);
+    while (!computer.hcf)
     {
-        long param1 = load(get_mode());
-        long param2 = load(get_mode());
+        computer.run();
+    }
+    assert(3000 == computer.output.front());
 
-        if (param1 == param2)
-        {
-            write(get_mode(), 1);
-        }
-        else
-        {
-            write(get_mode(), 0);
-        }
-    };
+    // And it works the same inside the real program
+    assert(86025 == run_program(kInput, {2}, true));
+}
 
-    void Rbo()
+void reset_test1()
+{
+    // A reset computer gives the same answers as a fresh one
+    IntCode computer(kInput);
+    computer.input.push_back(2);
+    while (!computer.hcf)
     {
-        relative_base += load(get_mode());
-    };
+        computer.run();
+    }
+    assert(86025 == computer.output.front());
 
-    ParameterMode get_mode()
+    computer.reset(kInput);
+    computer.input.push_back(1);
+    while (!computer.hcf)
     {
-        ParameterMode result = ParameterMode::Position;
-        if (modes.size())
-        {
-            result = modes.top();
-            modes.pop();
-        }
+        computer.run();
+    }
+    assert(1 == computer.output.size());
+    assert(3638931938 == computer.output.front());
 
-        return result;
-    };
+    // Including after running a different program
+    computer.reset(kSpinAdd);
+    computer.input.push_back(1000);
+    while (!computer.hcf)
+    {
+        computer.run();
+    }
+    assert(3000 == computer.output.front());
+
+    // A program bigger than the ram grows it
+    std::vector<long> big(3000, 0);
+    big[0] = 104;
+    big[1] = 42;
+    big[2] = 99;
+    big.back() = 7;
+    computer.reset(big);
+    computer.run();
+    assert(42 == computer.output.front());
+    assert(7 == computer.ram.back());
+}
+
+void stream_test1()
+{
+    // Both parts at once on one loop, one over text and one over binary
+    int text_in[2], text_out[2], binary_in[2], binary_out[2];
+    int piped = pipe(text_in) | pipe(text_out) | pipe(binary_in) | pipe(binary_out);
+    assert(0 == piped);
+
+    ssize_t written = write(text_in[1], "1\n", 2);
+    assert(2 == written);
+    close(text_in[1]);
+    int64_t mode{2};
+    written = write(binary_in[1], &mode, sizeof(mode));
+    assert(sizeof(mode) == written);
+    close(binary_in[1]);
+
+    IntCode boost(kInput), sensor(kInput);
+    StreamLoop<IntCode> loop;
+    size_t first = loop.attach(boost, text_in[0], text_out[1], Framing::Text);
+    size_t second = loop.attach(sensor, binary_in[0], binary_out[1], Framing::Binary);
+    loop.run();
+    assert(StreamStatus::Halted == loop.status(first));
+    assert(StreamStatus::Halted == loop.status(second));
+
+    char text[32]{};
+    ssize_t got = read(text_out[0], text, sizeof(text));
+    assert(11 == got);
+    assert(std::string("3638931938\n") == text);
+    int64_t coordinates;
+    got = read(binary_out[0], &coordinates, sizeof(coordinates));
+    assert(sizeof(coordinates) == got);
+    assert(86025 == coordinates);
+
+    // A program left waiting on a closed input reports it
+    int empty_in[2], empty_out[2];
+    piped = pipe(empty_in) | pipe(empty_out);
+    assert(0 == piped);
+    close(empty_in[1]);
+    IntCode waiting(kInput);
+    StreamLoop<IntCode> starved;
+    size_t index = starved.attach(waiting, empty_in[0], empty_out[1], Framing::Text);
+    starved.run();
+    assert(StreamStatus::Starved == starved.status(index));
+
+    // So is one whose input isn't a number, or is too big for a word
+    // And one fed a token longer than the read buffer, which must not wait
+    // for end of file behind a full buffer
+    std::string oversized(70000, '1');
+    for (std::string bad : {"x1\n", "1x\n", "99999999999999999999\n", oversized.c_str()})
+    {
+        int bad_in[2], bad_out[2];
+        piped = pipe(bad_in) | pipe(bad_out);
+        assert(0 == piped);
+
+        // Grow the pipe so the oversized token fits in one write
+        int capacity = fcntl(bad_in[1], F_SETPIPE_SZ, 1 << 20);
+        assert(capacity >= static_cast<int>(bad.size()));
+        written = write(bad_in[1], bad.data(), bad.size());
+        assert(static_cast<ssize_t>(bad.size()) == written);
+        close(bad_in[1]);
+
+        IntCode confused(kInput);
+        StreamLoop<IntCode> rejected;
+        index = rejected.attach(confused, bad_in[0], bad_out[1], Framing::Text);
+        rejected.run();
+        assert(StreamStatus::BadInput == rejected.status(index));
+        assert(confused.blocked && confused.input.empty());
+        close(bad_in[0]);
+        close(bad_out[0]);
+    }
 
-    // Members
-public:
-    bool hcf{false}; // Flag to Halt Catch Fire
-    bool halt{false};
-    long relative_base{0};
-    std::vector<long>::iterator pc;
-    OpCode opcode;
-    std::stack<ParameterMode> modes;
-    std::vector<long> ram;
-    std::deque<long> input;
-    std::queue<long> output;
-};
+    // A socket whose peer has gone is reported without raising SIGPIPE
+    int orphan_in[2], orphan_out[2];
+    piped = pipe(orphan_in) | socketpair(AF_UNIX, SOCK_STREAM, 0, orphan_out);
+    assert(0 == piped);
+    written = write(orphan_in[1], "1\n", 2);
+    assert(2 == written);
+    close(orphan_in[1]);
+    close(orphan_out[1]);
+    IntCode orphan(kInput);
+    StreamLoop<IntCode> unread;
+    index = unread.attach(orphan, orphan_in[0], orphan_out[0], Framing::Text);
+    unread.run();
+    assert(StreamStatus::Broken == unread.status(index));
+    close(orphan_in[0]);
+
+    for (int fd : {text_in[0], text_out[0], binary_in[0], binary_out[0], empty_in[0], empty_out[0]})
+    {
+        close(fd);
+    }
+}
 
-void part1_test1()
+// Time each corpus program with and without fast-forwarding
+void cycle_benchmark()
 {
-    std::vector<long> input{109, 1, 204, -1, 1001, 100, 1, 100, 1008, 100, 16, 101, 1006, 101, 0, 99};
-    std::vector<long> results;
-    IntCode computer(input);
-    while (!computer.hcf)
+    const std::vector<std::pair<const char *, std::pair<std::vector<long>, std::vector<long>>>> corpus{
+        {"spin add", {kSpinAdd, {10000000}}},
+        {"two counters", {kTwoCounters, {10000000}}},
+        {"relative counters", {kRelativeCounters, {10000000}}},
+        {"nested loops", {kNestedLoops, {100000, 100}}},
+        {"triangle", {kTriangle, {10000000}}},
+    };
+
+    for (const auto &entry : corpus)
     {
-        computer.run();
-        if (!computer.output.empty())
+        for (bool fast_forward : {false, true})
         {
-            results.push_back(computer.output.front());
-            computer.output.pop();
+            auto start = std::chrono::steady_clock::now();
+            long result = run_program(entry.second.first, entry.second.second, fast_forward);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << entry.first << (fast_forward ? " (fast-forward): " : ": ")
+                      << result << " in " << elapsed.count() << "s" << std::endl;
         }
     }
-
-    assert(results == input);
 }
 
-void part1_test2()
+// Run a workload to completion and return the sum of its outputs
+int64_t run_workload(const Workload<long> &workload, bool fast_forward)
 {
-    std::vector<long> input{1102, 34915192, 34915192, 7, 4, 7, 99, 0};
-    long result{0};
-    IntCode computer(input);
-    while (!computer.hcf)
+    IntCode computer(workload.program);
+    computer.fast_forward = fast_forward;
+    computer.input.assign(workload.input.begin(), workload.input.end());
+
+    int64_t sum{0};
+    while (!computer.hcf && !computer.blocked)
     {
         computer.run();
-        if (!computer.output.empty())
+        while (!computer.output.empty())
         {
-            result = computer.output.front();
+            sum += computer.output.front();
             computer.output.pop();
         }
     }
+    return sum;
+}
 
-    assert(1219070632396864 == result);
+// Every generated workload on the interpreter, with and without fast-forward
+void workload_benchmark()
+{
+    std::vector<Workload<long>> suite = workload_suite<long>(2048, true);
+    for (bool fast_forward : {false, true})
+    {
+        run_workloads(fast_forward ? "day9 fast-forward" : "day9", suite, [&](const Workload<long> &workload) {
+            return run_workload(workload, fast_forward);
+        });
+    }
 }
 
-void part1_test3()
+// Batches of workload jobs on the thread pool libintcode runs batches on,
+// growing the pool to show how throughput scales with threads
+void scaling_benchmark()
 {
-    std::vector<long> input{104, 1125899906842624, 99};
-    long result{0};
-    IntCode computer(input);
-    while (!computer.hcf)
+    const size_t kJobs{32};
+    const std::vector<Workload<long>> suite{
+        arithmetic_loop<long>(1000000),
+        self_modifying<long>(1000000),
+        memory_walk<long>(512, 2000),
+        recursion<long>(128, 10000),
+    };
+
+    for (unsigned threads : {1u, 2u, 4u, 8u})
     {
-        computer.run();
-        if (!computer.output.empty())
+        ThreadPool pool(threads);
+        for (const Workload<long> &workload : suite)
         {
-            result = computer.output.front();
-            computer.output.pop();
+            std::vector<int64_t> sums(kJobs);
+            auto start = std::chrono::steady_clock::now();
+            pool.parallel_for(kJobs, [&](size_t i) { sums[i] = run_workload(workload, false); });
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            bool right = std::all_of(sums.begin(), sums.end(), [&](int64_t sum) { return sum == workload.expected; });
+            std::cout << "day9 " << threads << " threads " << workload.name << " " << workload.size << ": "
+                      << kJobs * workload.instructions / elapsed.count() / 1e6 << " M instructions/s"
+                      << (right ? "" : " WRONG") << std::endl;
         }
     }
-
-    assert(1125899906842624 == result);
 }
 
 long part1()
@@ -382,12 +543,40 @@ long part2()
     return result;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    // Run the BOOST program as a filter from stdin to stdout
+    if (argc > 1 && std::string(argv[1]) == "--stream")
+    {
+        // A reader that goes away ends the stream as Broken instead of killing us
+        std::signal(SIGPIPE, SIG_IGN);
+
+        Framing framing = (argc > 2 && std::string(argv[2]) == "binary") ? Framing::Binary : Framing::Text;
+        IntCode computer(kInput);
+        StreamLoop<IntCode> loop;
+        loop.attach(computer, STDIN_FILENO, STDOUT_FILENO, framing, false);
+        loop.run();
+        return (loop.status(0) == StreamStatus::Halted) ? 0 : 1;
+    }
+
     part1_test1();
     part1_test2();
     part1_test3();
+    trace_test1();
+    trace_test2();
+    trace_test3();
+    run_for_test1();
+    checkpoint_test1();
+    cycle_test1();
+    reset_test1();
+    stream_test1();
 
     std::cout << "Part 1: " << part1() << std::endl;
     std::cout << "Part 2: " << part2() << std::endl;
+
+#ifdef BENCHMARK
+    cycle_benchmark();
+    workload_benchmark();
+    scaling_benchmark();
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * C interface to the day 9 Intcode computer, for linking as a shared library:
+ *
+ *   g++ -std=c++17 -O2 -shared -fPIC -fvisibility=hidden -pthread \
+ *       -o libintcode.so day9/libintcode.cpp
+ *
+ * Programs are registered once and referred to by handle afterwards. Jobs
+ * are submitted in batches and run on a thread pool owned by the library.
+ */
+#ifndef INTCODE_H
+#define INTCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define INTCODE_API __attribute__((visibility("default")))
+#else
+#define INTCODE_API
+#endif
+
+/* Bumped whenever the layout of intcode_job or the meaning of a call changes */
+#define INTCODE_ABI_VERSION 2
+
+typedef struct intcode_program intcode_program;
+
+typedef enum intcode_status
+{
+    INTCODE_HALTED = 0,    /* Ran to Hcf */
+    INTCODE_BLOCKED = 1,   /* Needed more input than the job supplied */
+    INTCODE_EXHAUSTED = 2, /* Ran out of its instruction budget */
+    INTCODE_FAULT = 3,     /* Accessed memory outside of ram */
+    INTCODE_ERROR = 4      /* The library failed, e.g. ran out of memory */
+} intcode_status;
+
+typedef struct intcode_job
+{
+    /* Filled in by the caller */
+    const intcode_program *program;
+    const int64_t *input;
+    size_t input_count;
+    int64_t *output;
+    size_t output_capacity;
+
+    /* Filled in by intcode_run_batch. output_count can exceed
+       output_capacity, in which case only the first output_capacity values
+       were stored. */
+    size_t output_count;
+    uint64_t retired;
+    intcode_status status;
+} intcode_job;
+
+INTCODE_API int intcode_abi_version(void);
+
+/* Parse a program once for any number of jobs. Returns NULL if the program
+   doesn't fit in ram or memory ran out. */
+INTCODE_API intcode_program *intcode_register(const int64_t *words, size_t count);
+
+/* Release a program. No job using it may be running. */
+INTCODE_API void intcode_release(intcode_program *program);
+
+/* Size the thread pool. Takes effect on the next batch, 0 means one thread
+   per hardware thread. Returns 0, or -1 if the size couldn't be changed. */
+INTCODE_API int intcode_set_threads(unsigned threads);
+
+/* Run every job to completion, or until it retires budget instructions if
+   budget is non-zero, spread across the thread pool. Blocks until the whole
+   batch is done. Returns the number of jobs that halted. If the batch can't
+   be started at all every job gets INTCODE_ERROR. */
+INTCODE_API size_t intcode_run_batch(intcode_job *jobs, size_t count, uint64_t budget);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
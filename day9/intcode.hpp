@@ -0,0 +1,1343 @@
+// The day 9 Intcode computer, shared by the puzzle and the runtime library
+
+#include <vector>
+#include <queue>
+#include <deque>
+#include <map>
+#include <array>
+#include <utility>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum ParameterMode
+{
+    Position,
+    Immediate,
+    Relative
+};
+
+enum OpCode
+{
+    Nop,
+    Add,
+    Mul,
+    In,
+    Out,
+    Jit,
+    Jif,
+    Lt,
+    Eq,
+    Rbo,
+    Hcf = 99
+};
+
+// Why a budgeted run stopped
+enum RunStatus
+{
+    Halted,    // Hit Hcf
+    Yielded,   // Produced an output
+    Blocked,   // Waiting on input
+    Exhausted  // Ran out of instructions
+};
+
+// Number of backward jumps to the same address before we record its loop
+static const int kTraceThreshold{16};
+
+// Longest loop body we're willing to record
+static const size_t kMaxTraceLength{256};
+
+// Times a loop can rewrite its own traced code before we stop tracing it
+static const int kMaxRetraces{2};
+
+// Periods in a row a loop header can fail to repeat before cycle detection
+// gives up on it and leaves it to tracing
+static const int kMaxSampleMisses{8};
+
+// A recorded instruction with its parameter modes and parameter words resolved
+// at record time, so replaying it skips decode entirely
+struct TraceOp
+{
+    OpCode opcode{Nop};
+    int addr;
+    int length;
+    long word;
+    std::array<ParameterMode, 3> modes;
+    std::array<long, 3> params;
+    bool taken; // Branch direction seen while recording
+};
+
+// A recorded loop body, replayed whenever a backward jump lands on its header
+struct Trace
+{
+    int header;
+    std::vector<TraceOp> ops;
+    bool live{true}; // Cleared once a write lands on the code it covers
+};
+
+// Seed for hashing loop state
+static const uint64_t kHashSeed{0xcbf29ce484222325};
+
+// A value during symbolic replay of a loop period, its value in the current
+// period plus how much it changes each period after that
+struct Affine
+{
+    long value;
+    long slope;
+};
+
+// Number of parameters following an opcode
+constexpr int parameter_count(OpCode opcode)
+{
+    switch (opcode)
+    {
+        case OpCode::Add:
+        case OpCode::Mul:
+        case OpCode::Lt:
+        case OpCode::Eq:  return 3;
+        case OpCode::Jit:
+        case OpCode::Jif: return 2;
+        case OpCode::In:
+        case OpCode::Out:
+        case OpCode::Rbo: return 1;
+        default:          return 0;
+    }
+}
+
+class IntCode;
+typedef void (IntCode::*Handler)();
+
+// Everything decode() needs to know about one instruction word
+struct Decoded
+{
+    OpCode opcode;
+    std::array<ParameterMode, 3> modes;
+    Handler handler;
+};
+
+// Handlers are numbered opcode slot * 27 + mode1 + 3 * mode2 + 9 * mode3.
+// Slot 0 is for words that aren't legal instructions, and Hcf takes the slot
+// after Rbo.
+static const int kModeCombinations{27};
+static const int kHandlerCount{11 * kModeCombinations};
+
+// The largest legal instruction word is 22299, Hcf with three relative modes
+static const int kInstructionWords{22300};
+
+constexpr OpCode slot_opcode(int slot)
+{
+    return (slot == 10) ? OpCode::Hcf : static_cast<OpCode>(slot);
+}
+
+// Handler number of every legal instruction word, worked out at compile time
+constexpr std::array<unsigned short, kInstructionWords> make_decode_table()
+{
+    std::array<unsigned short, kInstructionWords> table{};
+    for (int word = 0; word < kInstructionWords; word++)
+    {
+        int code = word % 100;
+        int slot = (code >= OpCode::Add && code <= OpCode::Rbo) ? code : (code == OpCode::Hcf) ? 10 : 0;
+        int mode1 = word / 100 % 10;
+        int mode2 = word / 1000 % 10;
+        int mode3 = word / 10000 % 10;
+
+        if (slot && mode1 <= Relative && mode2 <= Relative && mode3 <= Relative)
+        {
+            table[word] = slot * kModeCombinations + mode1 + 3 * mode2 + 9 * mode3;
+        }
+    }
+
+    return table;
+}
+
+static constexpr std::array<unsigned short, kInstructionWords> kDecodeTable = make_decode_table();
+
+class IntCode
+{
+public:
+    // Default constructor with empty ram
+    IntCode()
+    {
+        ram.reserve(2048);
+        std::fill_n(std::back_inserter(ram), 2048, 0);
+        pc = ram.begin();
+
+        init_tiers();
+    };
+
+    // Initialize the ram of the CPU with a set of ints
+    IntCode(std::vector<long> input)
+    {
+        ram.reserve(2048);
+        std::fill_n(std::back_inserter(ram), 2048, 0);
+
+        auto i = ram.begin();
+        for (long data : input)
+        {
+            *i = data;
+            i++;
+        }
+
+        pc = ram.begin();
+
+        init_tiers();
+    };
+
+    //~IntCode(){};
+
+    // Size the per-address tables used by tracing and cycle detection
+    void init_tiers()
+    {
+        trace_at.assign(ram.size(), -1);
+        hotness.assign(ram.size(), 0);
+        traced_code.assign(ram.size(), 0);
+        retraces.assign(ram.size(), 0);
+        sample_misses.assign(ram.size(), 0);
+        dirty_epoch.assign(ram.size(), 0);
+    };
+
+    // Load a new program into this computer, reusing its ram and tables.
+    // Traces survive if the new program has the same code under them, so a
+    // computer that keeps running one program stays warm.
+    void reset(const std::vector<long> &program)
+    {
+        // A bigger program gets more ram, and starts with no traces
+        if (program.size() > ram.size())
+        {
+            ram.resize(program.size());
+            init_tiers();
+            traces.clear();
+        }
+
+        std::fill(ram.begin(), ram.end(), 0);
+        std::copy(program.begin(), program.end(), ram.begin());
+        pc = ram.begin();
+
+        hcf = false;
+        halt = false;
+        blocked = false;
+        retired = 0;
+        retire_limit = 0;
+        relative_base = 0;
+        opcode = Nop;
+        handler = &IntCode::Ignore;
+        input.clear();
+        output = std::queue<long>();
+
+        backedge = false;
+        recording = false;
+        pending = Trace{};
+        std::fill(hotness.begin(), hotness.end(), 0);
+        if (!std::all_of(traces.begin(), traces.end(), [this](const Trace &trace) { return !trace.live || matches(trace); }))
+        {
+            clear_traces();
+        }
+
+        periods_skipped = 0;
+        sampling = false;
+        period_io = false;
+        std::fill(sample_misses.begin(), sample_misses.end(), 0);
+        epoch = 1;
+        std::fill(dirty_epoch.begin(), dirty_epoch.end(), 0);
+        dirty.clear();
+        sample_header = -1;
+        sample_hash = 0;
+        sample_at = 0;
+        sample_length = 0;
+        sample_rb = 0;
+        sample_deltas.clear();
+    };
+
+    // Infinite loop until cpu halts
+    void run()
+    {
+        run_for(std::numeric_limits<unsigned long>::max());
+    };
+
+    // Run at most budget instructions, stopping early on output, on an In
+    // with no input waiting, or when the cpu halts
+    RunStatus run_for(unsigned long budget)
+    {
+        blocked = false;
+        retire_limit = retired + std::min(budget, std::numeric_limits<unsigned long>::max() - retired);
+
+        while (!hcf && !halt && !blocked && retired < retire_limit)
+        {
+            int addr = pc - ram.begin();
+            decode();
+
+            if (recording)
+            {
+                TraceOp op = capture(addr);
+                execute();
+                record(op);
+            }
+            else
+            {
+                execute();
+            }
+            retired++;
+
+            if (backedge)
+            {
+                enter_loop();
+            }
+        }
+
+        RunStatus status = hcf ? Halted : halt ? Yielded : blocked ? Blocked : Exhausted;
+
+        // The In that blocked didn't retire
+        if (blocked)
+        {
+            retired--;
+        }
+
+        halt = false;
+        return status;
+    };
+
+    // Decode the instruction at pc through the decode table
+    // Sets opcode, parameter modes and the handler specialized for them
+    void decode()
+    {
+        long word = *pc;
+        const Decoded &decoded = kDecoded[(word >= 0 && word < kInstructionWords) ? kDecodeTable[word] : 0];
+        opcode = decoded.opcode;
+        modes = decoded.modes;
+        handler = decoded.handler;
+
+        // We've decoded the opcode and parameter modes, increment PC
+        pc++;
+    };
+
+    void execute()
+    {
+        (this->*handler)();
+    };
+
+    void write(int addr, long data)
+    {
+        long &cell = ram.at(addr);
+
+        // Remember what each cell held when the current loop period began
+        if (sampling && dirty_epoch[addr] != epoch)
+        {
+            dirty_epoch[addr] = epoch;
+            dirty.emplace_back(addr, cell);
+        }
+
+        cell = data;
+
+        // Self-modifying code invalidates any trace recorded over it
+        if (traced_code[addr])
+        {
+            invalidate_traces(addr);
+        }
+    };
+
+    template <ParameterMode M>
+    void write(long data)
+    {
+        if constexpr (M == ParameterMode::Relative)
+        {
+            write(relative_base + *pc++, data);
+        }
+        else
+        {
+            write(*pc++, data);
+        }
+    };
+
+    long read(int addr)
+    {
+        return ram.at(addr);
+    };
+
+    template <ParameterMode M>
+    long load()
+    {
+        if constexpr (M == ParameterMode::Immediate)
+        {
+            return *pc++;
+        }
+        else if constexpr (M == ParameterMode::Relative)
+        {
+            return read(relative_base + *pc++);
+        }
+        else // if constexpr (M == ParameterMode::Position)
+        {
+            return read(*pc++);
+        }
+    }
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Add()
+    {
+        // Get parameter 1
+        long param1 = load<M1>();
+
+        // Get parameter 2
+        long param2 = load<M2>();
+
+        // Write the result and increment PC
+        write<M3>(param1 + param2);
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Mul()
+    {
+        // Get parameter 1
+        long param1 = load<M1>();
+
+        // Get parameter 2
+        long param2 = load<M2>();
+
+        // Write the result
+        write<M3>(param1 * param2);
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void In()
+    {
+        // Rewind so the In runs again once there's input
+        if (input.empty())
+        {
+            pc--;
+            blocked = true;
+            return;
+        }
+
+        // Write input to ram
+        long data = input.front();
+        input.pop_front();
+        period_io = true;
+
+        write<M1>(data);
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Out()
+    {
+        // Load data to output
+        long param1 = load<M1>();
+
+        // Output
+        output.push(param1);
+        halt = true;
+        period_io = true;
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Hcf()
+    {
+        hcf = true;
+        pc++;
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Jit()
+    {
+        int addr = pc - ram.begin() - 1;
+        long param1 = load<M1>();
+        long param2 = load<M2>();
+        
+        if (param1)
+        {
+            pc = (ram.begin() + param2);
+            backedge = (param2 < addr);
+        }
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Jif()
+    {
+        int addr = pc - ram.begin() - 1;
+        long param1 = load<M1>();
+        long param2 = load<M2>();
+        
+        if (!param1)
+        {
+            pc = (ram.begin() + param2);
+            backedge = (param2 < addr);
+        }
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Lt()
+    {
+        long param1 = load<M1>();
+        long param2 = load<M2>();
+
+        write<M3>(param1 < param2);
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Eq()
+    {
+        long param1 = load<M1>();
+        long param2 = load<M2>();
+
+        write<M3>(param1 == param2);
+    };
+
+    template <ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    void Rbo()
+    {
+        relative_base += load<M1>();
+    };
+
+    // Words that aren't legal instructions do nothing
+    void Ignore()
+    {
+    };
+
+    // Pick the handler for an exact opcode and set of modes. Modes of
+    // parameters an opcode doesn't have are ignored, so they share a handler.
+    template <OpCode Op, ParameterMode M1, ParameterMode M2, ParameterMode M3>
+    static constexpr Handler handler_for()
+    {
+        constexpr int n = parameter_count(Op);
+        constexpr ParameterMode P1 = (n > 0) ? M1 : Position;
+        constexpr ParameterMode P2 = (n > 1) ? M2 : Position;
+        constexpr ParameterMode P3 = (n > 2) ? M3 : Position;
+
+        if constexpr (Op == OpCode::Add) return &IntCode::Add<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Mul) return &IntCode::Mul<P1, P2, P3>;
+        else if constexpr (Op == OpCode::In)  return &IntCode::In<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Out) return &IntCode::Out<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jit) return &IntCode::Jit<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Jif) return &IntCode::Jif<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Lt)  return &IntCode::Lt<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Eq)  return &IntCode::Eq<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Rbo) return &IntCode::Rbo<P1, P2, P3>;
+        else if constexpr (Op == OpCode::Hcf) return &IntCode::Hcf<P1, P2, P3>;
+        else return &IntCode::Ignore;
+    };
+
+    template <std::size_t I>
+    static constexpr Decoded make_decoded()
+    {
+        constexpr OpCode op = slot_opcode(I / kModeCombinations);
+        constexpr ParameterMode m1 = static_cast<ParameterMode>(I % 3);
+        constexpr ParameterMode m2 = static_cast<ParameterMode>(I / 3 % 3);
+        constexpr ParameterMode m3 = static_cast<ParameterMode>(I / 9 % 3);
+
+        return Decoded{op, {m1, m2, m3}, handler_for<op, m1, m2, m3>()};
+    };
+
+    template <std::size_t... I>
+    static constexpr std::array<Decoded, sizeof...(I)> make_decoded(std::index_sequence<I...>)
+    {
+        return {{make_decoded<I>()...}};
+    };
+
+    // Called after a backward jump, replay the loop's trace if we have one,
+    // otherwise count the jump and start recording once the loop is hot
+    void enter_loop()
+    {
+        backedge = false;
+
+        int header = pc - ram.begin();
+        if (header < 0 || header >= static_cast<int>(ram.size()))
+        {
+            return;
+        }
+
+        // Cycle detection samples loop headers until they've shown they
+        // don't repeat, after which they're traced like any other loop
+        if (fast_forward && sample_misses[header] < kMaxSampleMisses)
+        {
+            sample_loop();
+            return;
+        }
+
+        // Writes aren't logged from here on, so the period in progress can't
+        // be compared with anything
+        sampling = false;
+
+        if (recording)
+        {
+            return;
+        }
+
+        if (trace_at[header] >= 0)
+        {
+            run_trace(trace_at[header]);
+        }
+        else if (trace_threshold && retraces[header] <= kMaxRetraces && ++hotness[header] >= trace_threshold)
+        {
+            recording = true;
+            pending = Trace{header, {}};
+        }
+    };
+
+    // Compare what the last period did to memory with the period before it.
+    // Two periods in a row at the same header, with the same length, the same
+    // relative base and the same change to every written cell, make the loop
+    // a candidate for fast-forwarding.
+    void sample_loop()
+    {
+        int header = pc - ram.begin();
+        bool tracked = sampling;
+        sampling = true;
+
+        std::vector<std::pair<int, long>> &deltas = period_deltas;
+        deltas.clear();
+        for (const auto &entry : dirty)
+        {
+            long delta = ram[entry.first] - entry.second;
+            if (delta)
+            {
+                deltas.emplace_back(entry.first, delta);
+            }
+        }
+        std::sort(deltas.begin(), deltas.end());
+
+        uint64_t hash = mix(mix(kHashSeed, header), relative_base);
+        for (const auto &delta : deltas)
+        {
+            hash = mix(mix(hash, delta.first), delta.second);
+        }
+
+        unsigned long length = retired - sample_at;
+        bool repeated = tracked && !period_io && !deltas.empty() &&
+                        header == sample_header &&
+                        relative_base == sample_rb &&
+                        hash == sample_hash &&
+                        length == sample_length &&
+                        deltas == sample_deltas;
+
+        bool miss = tracked && header == sample_header && !repeated;
+
+        sample_header = header;
+        sample_hash = hash;
+        sample_rb = relative_base;
+        sample_length = length;
+        std::swap(sample_deltas, period_deltas);
+        sample_at = retired;
+
+        // Start a fresh period
+        dirty.clear();
+        period_io = false;
+        if (++epoch == 0)
+        {
+            std::fill(dirty_epoch.begin(), dirty_epoch.end(), 0);
+            epoch = 1;
+        }
+
+        if (repeated && !skip_periods())
+        {
+            miss = true;
+        }
+        sample_misses[header] = miss ? sample_misses[header] + 1 : 0;
+    };
+
+    static uint64_t mix(uint64_t hash, long data)
+    {
+        hash ^= static_cast<uint64_t>(data) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+        return hash;
+    };
+
+    // Change per period of a cell, as seen over the last period
+    long slope_of(long addr)
+    {
+        auto found = std::lower_bound(sample_deltas.begin(), sample_deltas.end(), std::make_pair(static_cast<int>(addr), std::numeric_limits<long>::min()));
+        return (found != sample_deltas.end() && found->first == addr) ? found->second : 0;
+    };
+
+    // Symbolically replay one period from the header, with every cell as its
+    // current value plus its observed change per period. Returns how many
+    // periods in a row are guaranteed to take exactly the same path, or 0 if
+    // the period isn't a pure counter update.
+    unsigned long stable_periods()
+    {
+        const unsigned long forever = std::numeric_limits<unsigned long>::max();
+        unsigned long stable = forever;
+        std::map<long, Affine> written;
+        long rb = relative_base;
+        long ip = pc - ram.begin();
+        bool ok = true;
+
+        auto in_ram = [&](long addr) { return addr >= 0 && addr < static_cast<long>(ram.size()); };
+
+        auto cell = [&](long addr) -> Affine {
+            if (!in_ram(addr))
+            {
+                ok = false;
+                return Affine{0, 0};
+            }
+            auto found = written.find(addr);
+            return (found != written.end()) ? found->second : Affine{ram[addr], slope_of(addr)};
+        };
+
+        // Code has to stay put for the replay to mean anything
+        auto code = [&](long addr) -> long {
+            Affine word = cell(addr);
+            if (word.slope || written.count(addr))
+            {
+                ok = false;
+            }
+            return word.value;
+        };
+
+        // Periods until value + k * slope first changes between zero and non-zero
+        auto until_zero = [&](Affine a) -> unsigned long {
+            if (!a.slope)
+            {
+                return forever;
+            }
+            if (!a.value)
+            {
+                return 1;
+            }
+            if (-a.value % a.slope == 0 && -a.value / a.slope > 0)
+            {
+                return -a.value / a.slope;
+            }
+            return forever;
+        };
+
+        // Periods until value + k * slope first changes sign
+        auto until_sign = [&](Affine a) -> unsigned long {
+            if (a.value < 0 && a.slope > 0)
+            {
+                return (-a.value + a.slope - 1) / a.slope;
+            }
+            if (a.value >= 0 && a.slope < 0)
+            {
+                return a.value / -a.slope + 1;
+            }
+            return forever;
+        };
+
+        for (unsigned long n = 0; ok && n < sample_length; n++)
+        {
+            long word = code(ip);
+            OpCode op = static_cast<OpCode>(word % 100);
+            int length = 1 + parameter_count(op);
+            std::array<long, 3> mode{word / 100 % 10, word / 1000 % 10, word / 10000 % 10};
+
+            auto operand = [&](int i) -> Affine {
+                long param = code(ip + 1 + i);
+                if (mode[i] == ParameterMode::Immediate)
+                {
+                    return Affine{param, 0};
+                }
+                return cell(mode[i] == ParameterMode::Relative ? rb + param : param);
+            };
+
+            auto target = [&](int i) -> long {
+                long param = code(ip + 1 + i);
+                long addr = (mode[i] == ParameterMode::Relative) ? rb + param : param;
+                ok = ok && in_ram(addr);
+                return addr;
+            };
+
+            long next = ip + length;
+            switch (op)
+            {
+                case OpCode::Add:
+                {
+                    Affine a = operand(0), b = operand(1);
+                    written[target(2)] = Affine{a.value + b.value, a.slope + b.slope};
+                    break;
+                }
+                case OpCode::Mul:
+                {
+                    // Only scaling by a constant keeps the cell a counter
+                    Affine a = operand(0), b = operand(1);
+                    ok = ok && (!a.slope || !b.slope);
+                    written[target(2)] = Affine{a.value * b.value, a.slope * b.value + a.value * b.slope};
+                    break;
+                }
+                case OpCode::Lt:
+                {
+                    Affine a = operand(0), b = operand(1);
+                    Affine diff{a.value - b.value, a.slope - b.slope};
+                    stable = std::min(stable, until_sign(diff));
+                    written[target(2)] = Affine{diff.value < 0, 0};
+                    break;
+                }
+                case OpCode::Eq:
+                {
+                    Affine a = operand(0), b = operand(1);
+                    Affine diff{a.value - b.value, a.slope - b.slope};
+                    stable = std::min(stable, until_zero(diff));
+                    written[target(2)] = Affine{diff.value == 0, 0};
+                    break;
+                }
+                case OpCode::Jit:
+                case OpCode::Jif:
+                {
+                    Affine condition = operand(0), destination = operand(1);
+                    ok = ok && !destination.slope;
+                    stable = std::min(stable, until_zero(condition));
+                    if ((condition.value != 0) == (op == OpCode::Jit))
+                    {
+                        next = destination.value;
+                    }
+                    break;
+                }
+                case OpCode::Rbo:
+                {
+                    Affine offset = operand(0);
+                    ok = ok && !offset.slope;
+                    rb += offset.value;
+                    break;
+                }
+
+                // I/O and halting end the period
+                default:
+                    return 0;
+            }
+            ip = next;
+        }
+
+        // The period has to end back at the header with every written cell
+        // moving by exactly the change we observed
+        if (!ok || ip != pc - ram.begin() || rb != relative_base)
+        {
+            return 0;
+        }
+        for (const auto &entry : written)
+        {
+            long delta = slope_of(entry.first);
+            if (entry.second.slope != delta || entry.second.value != ram[entry.first] + delta)
+            {
+                return 0;
+            }
+        }
+        for (const auto &delta : sample_deltas)
+        {
+            if (!written.count(delta.first))
+            {
+                return 0;
+            }
+        }
+
+        return stable;
+    };
+
+    // Advance every counter by as many whole periods as we can prove take the
+    // same path, without overrunning the instruction budget. False if the
+    // loop turned out not to be a pure counter update.
+    bool skip_periods()
+    {
+        unsigned long stable = stable_periods();
+        if (!stable)
+        {
+            return false;
+        }
+
+        unsigned long periods = std::min(stable, (retire_limit - retired) / sample_length);
+        if (!periods)
+        {
+            return true;
+        }
+
+        // Give up rather than wrap a counter around
+        std::vector<long> values;
+        for (const auto &delta : sample_deltas)
+        {
+            long step, value;
+            if (periods > static_cast<unsigned long>(std::numeric_limits<long>::max()) ||
+                __builtin_mul_overflow(static_cast<long>(periods), delta.second, &step) ||
+                __builtin_add_overflow(ram[delta.first], step, &value))
+            {
+                return true;
+            }
+            values.push_back(value);
+        }
+
+        // Counters bypass write() so the new period starts clean, but another
+        // loop's trace may still be reading one as code
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            int addr = sample_deltas[i].first;
+            ram[addr] = values[i];
+            if (traced_code[addr])
+            {
+                invalidate_traces(addr);
+            }
+        }
+
+        retired += periods * sample_length;
+        periods_skipped += periods;
+        sample_at = retired;
+        return true;
+    };
+
+    // Snapshot the instruction that was just decoded at addr
+    TraceOp capture(int addr)
+    {
+        TraceOp op{opcode, addr, 1 + parameter_count(opcode), ram.at(addr), modes, {0, 0, 0}, false};
+
+        for (int i = 0; i < op.length - 1; i++)
+        {
+            op.params[i] = ram.at(addr + 1 + i);
+        }
+
+        return op;
+    };
+
+    // Append an executed instruction to the trace being recorded, the trace
+    // is complete once control comes back around to its header
+    void record(TraceOp op)
+    {
+        switch (op.opcode)
+        {
+            case OpCode::Add:
+            case OpCode::Mul:
+            case OpCode::Lt:
+            case OpCode::Eq:
+            case OpCode::Rbo: break;
+            case OpCode::Jit:
+            case OpCode::Jif:
+                op.taken = (pc - ram.begin()) != (op.addr + op.length);
+                break;
+
+            // I/O and halting leave the trace to the interpreter
+            default:
+                recording = false;
+                return;
+        }
+
+        pending.ops.push_back(op);
+
+        if ((pc - ram.begin()) == pending.header)
+        {
+            compile();
+        }
+        else if (pending.ops.size() >= kMaxTraceLength)
+        {
+            recording = false;
+        }
+    };
+
+    // Install the recorded trace, unless the loop rewrote itself meanwhile
+    void compile()
+    {
+        recording = false;
+
+        if (!matches(pending))
+        {
+            hotness[pending.header] = 0;
+            retraces[pending.header]++;
+            return;
+        }
+
+        for (const TraceOp &op : pending.ops)
+        {
+            for (int i = 0; i < op.length; i++)
+            {
+                traced_code[op.addr + i]++;
+            }
+        }
+
+        trace_at[pending.header] = traces.size();
+        traces.push_back(std::move(pending));
+    };
+
+    // Whether the code in ram is still the code a trace was recorded from
+    bool matches(const Trace &trace)
+    {
+        for (const TraceOp &op : trace.ops)
+        {
+            if (ram.at(op.addr) != op.word)
+            {
+                return false;
+            }
+            for (int i = 0; i < op.length - 1; i++)
+            {
+                if (ram.at(op.addr + 1 + i) != op.params[i])
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    };
+
+    // Retire the traces recorded over addr. Their loops go back to the
+    // interpreter and may be traced again, up to kMaxRetraces times. Retired
+    // traces keep their slot, so traces never moves while one is replaying.
+    void invalidate_traces(int addr)
+    {
+        for (Trace &trace : traces)
+        {
+            if (!trace.live || !covers(trace, addr))
+            {
+                continue;
+            }
+
+            trace.live = false;
+            trace_at[trace.header] = -1;
+            hotness[trace.header] = 0;
+            retraces[trace.header]++;
+            for (const TraceOp &op : trace.ops)
+            {
+                for (int i = 0; i < op.length; i++)
+                {
+                    traced_code[op.addr + i]--;
+                }
+            }
+        }
+    };
+
+    static bool covers(const Trace &trace, int addr)
+    {
+        return std::any_of(trace.ops.begin(), trace.ops.end(), [addr](const TraceOp &op) {
+            return addr >= op.addr && addr < op.addr + op.length;
+        });
+    };
+
+    // Forget every trace, for when a different program is loaded
+    void clear_traces()
+    {
+        traces.clear();
+        std::fill(trace_at.begin(), trace_at.end(), -1);
+        std::fill(traced_code.begin(), traced_code.end(), 0);
+        std::fill(retraces.begin(), retraces.end(), 0);
+    };
+
+    long fetch(const TraceOp &op, int i)
+    {
+        if (op.modes[i] == ParameterMode::Immediate)
+        {
+            return op.params[i];
+        }
+        else if (op.modes[i] == ParameterMode::Relative)
+        {
+            return read(relative_base + op.params[i]);
+        }
+        else // if (op.modes[i] == ParameterMode::Position)
+        {
+            return read(op.params[i]);
+        }
+    };
+
+    void store(const TraceOp &op, int i, long data)
+    {
+        if (op.modes[i] == ParameterMode::Relative)
+        {
+            write(relative_base + op.params[i], data);
+        }
+        else
+        {
+            write(op.params[i], data);
+        }
+    };
+
+    // Replay a trace from its header until one of its guards fails, then
+    // hand control back to the interpreter. Nothing in here adds or removes
+    // traces, so the reference stays good even if the trace is retired.
+    void run_trace(int index)
+    {
+        const Trace &trace = traces[index];
+
+        // The budget is checked once per iteration, the interpreter finishes
+        // off whatever is left of it
+        while (retired + trace.ops.size() <= retire_limit)
+        {
+            retired += trace.ops.size();
+
+            for (size_t i = 0; i < trace.ops.size(); i++)
+            {
+                const TraceOp &op = trace.ops[i];
+                int next = (i + 1 < trace.ops.size()) ? trace.ops[i + 1].addr : trace.header;
+
+                switch (op.opcode)
+                {
+                    case OpCode::Add: store(op, 2, fetch(op, 0) + fetch(op, 1)); break;
+                    case OpCode::Mul: store(op, 2, fetch(op, 0) * fetch(op, 1)); break;
+                    case OpCode::Lt:  store(op, 2, fetch(op, 0) < fetch(op, 1)); break;
+                    case OpCode::Eq:  store(op, 2, fetch(op, 0) == fetch(op, 1)); break;
+                    case OpCode::Rbo: relative_base += fetch(op, 0); break;
+                    case OpCode::Jit:
+                    case OpCode::Jif:
+                    {
+                        bool taken = (fetch(op, 0) != 0) == (op.opcode == OpCode::Jit);
+                        long target = fetch(op, 1);
+
+                        // Guard, the branch must go the way it did when recorded
+                        if (taken != op.taken || (taken && target != next))
+                        {
+                            retired -= trace.ops.size() - i - 1;
+                            pc = ram.begin() + (taken ? target : op.addr + op.length);
+                            return;
+                        }
+                        break;
+                    }
+                    default: break;
+                }
+
+                // The loop rewrote its own code, so this trace is gone, but
+                // the instruction itself completed
+                if (!trace.live)
+                {
+                    retired -= trace.ops.size() - i - 1;
+                    pc = ram.begin() + next;
+                    return;
+                }
+            }
+        }
+
+        pc = ram.begin() + trace.header;
+    };
+
+    // Members
+public:
+    bool hcf{false}; // Flag to Halt Catch Fire
+    bool halt{false};
+    bool blocked{false}; // Waiting on input
+    unsigned long retired{0}; // Instructions executed so far
+    unsigned long retire_limit{0};
+    long relative_base{0};
+    std::vector<long>::iterator pc;
+    OpCode opcode{Nop};
+    std::array<ParameterMode, 3> modes{};
+    Handler handler{&IntCode::Ignore};
+
+    // Every (opcode, mode1, mode2, mode3) the decode table can point at
+    static const std::array<Decoded, kHandlerCount> kDecoded;
+    std::vector<long> ram;
+    std::deque<long> input;
+    std::queue<long> output;
+
+    // Trace tier
+    int trace_threshold{kTraceThreshold}; // 0 disables tracing
+    bool backedge{false};     // Last instruction jumped backwards
+    bool recording{false};
+    Trace pending;
+    std::vector<Trace> traces;     // Live and retired, indexed by trace_at
+    std::vector<int> trace_at;     // Live trace index for each loop header, or -1
+    std::vector<int> hotness;      // Backward jumps seen for each address
+    std::vector<int> traced_code;  // Live traces covering each address
+    std::vector<int> retraces;     // Traces retired or rejected at each loop header
+
+    // Cycle detection, tried on each loop before tracing when enabled
+    bool fast_forward{false}; // Skip whole periods of counter-only loops
+    unsigned long periods_skipped{0};
+    bool sampling{false};     // Writes are being logged for the current period
+    bool period_io{false};    // Input or output since the last loop header
+    std::vector<int> sample_misses; // Periods in a row each header failed to repeat
+    unsigned epoch{1};
+    std::vector<unsigned> dirty_epoch;       // Period each cell was last written in
+    std::vector<std::pair<int, long>> dirty; // Cells written this period, with their old value
+    int sample_header{-1};
+    uint64_t sample_hash{0};
+    unsigned long sample_at{0};
+    unsigned long sample_length{0};
+    long sample_rb{0};
+    std::vector<std::pair<int, long>> sample_deltas;
+    std::vector<std::pair<int, long>> period_deltas;
+};
+
+inline constexpr std::array<Decoded, kHandlerCount> IntCode::kDecoded = IntCode::make_decoded(std::make_index_sequence<kHandlerCount>{});
+
+// Checkpoint layout: header, one presence byte per ram page, pending input,
+// pending output, then the ram image starting on a page boundary. Pages that
+// are all zero are never written, so they stay holes in a sparse file.
+static const char kCheckpointMagic[8]{'I', 'N', 'T', 'C', 'K', 'P', 'T', '1'};
+static const size_t kCheckpointPage{4096};
+static const size_t kWordsPerPage{kCheckpointPage / sizeof(long)};
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint64_t pc;
+    int64_t relative_base;
+    uint64_t retired;
+    uint64_t ram_words;
+    uint64_t input_count;
+    uint64_t output_count;
+    uint8_t hcf;
+    uint8_t halt;
+};
+
+// Byte offset of the ram image, everything before it is metadata. Fails if
+// the header's counts are too big for the offset to fit in a size_t.
+inline bool checkpoint_ram_offset(const CheckpointHeader &header, size_t &offset)
+{
+    size_t pages = header.ram_words / kWordsPerPage + (header.ram_words % kWordsPerPage != 0);
+    size_t io, meta;
+    if (__builtin_add_overflow(header.input_count, header.output_count, &io) ||
+        __builtin_mul_overflow(io, sizeof(long), &io) ||
+        __builtin_add_overflow(sizeof(header) + pages, io, &meta) ||
+        __builtin_add_overflow(meta, kCheckpointPage - 1, &meta))
+    {
+        return false;
+    }
+
+    offset = meta / kCheckpointPage * kCheckpointPage;
+    return true;
+}
+
+// Suspend the computer to path. Traces aren't saved, loops get re-traced once
+// they run hot again after resuming.
+inline bool save_checkpoint(const IntCode &computer, const std::string &path)
+{
+    CheckpointHeader header{};
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+    header.pc = computer.pc - computer.ram.begin();
+    header.relative_base = computer.relative_base;
+    header.retired = computer.retired;
+    header.ram_words = computer.ram.size();
+    header.input_count = computer.input.size();
+    header.output_count = computer.output.size();
+    header.hcf = computer.hcf;
+    header.halt = computer.halt;
+
+    size_t pages = (header.ram_words + kWordsPerPage - 1) / kWordsPerPage;
+    std::vector<uint8_t> present(pages, 0);
+    for (size_t page = 0; page < pages; page++)
+    {
+        auto first = computer.ram.begin() + page * kWordsPerPage;
+        auto last = computer.ram.begin() + std::min((page + 1) * kWordsPerPage, computer.ram.size());
+        present[page] = std::any_of(first, last, [](long data) { return data != 0; });
+    }
+
+    // Gather all the metadata into one write
+    std::vector<char> meta(sizeof(header));
+    std::memcpy(meta.data(), &header, sizeof(header));
+    meta.insert(meta.end(), present.begin(), present.end());
+
+    std::queue<long> output = computer.output;
+    std::vector<long> pending(computer.input.begin(), computer.input.end());
+    while (!output.empty())
+    {
+        pending.push_back(output.front());
+        output.pop();
+    }
+    const char *bytes = reinterpret_cast<const char *>(pending.data());
+    meta.insert(meta.end(), bytes, bytes + pending.size() * sizeof(long));
+
+    size_t ram_offset;
+    if (!checkpoint_ram_offset(header, ram_offset))
+    {
+        return false;
+    }
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    bool ok = pwrite(fd, meta.data(), meta.size(), 0) == static_cast<ssize_t>(meta.size());
+    for (size_t page = 0; ok && page < pages; page++)
+    {
+        if (present[page])
+        {
+            size_t words = std::min(kWordsPerPage, computer.ram.size() - page * kWordsPerPage);
+            size_t size = words * sizeof(long);
+            ok = pwrite(fd, computer.ram.data() + page * kWordsPerPage, size,
+                        ram_offset + page * kCheckpointPage) == static_cast<ssize_t>(size);
+        }
+    }
+
+    // Extend the file over any trailing zero pages
+    ok = ok && ftruncate(fd, ram_offset + header.ram_words * sizeof(long)) == 0;
+
+    close(fd);
+    return ok;
+}
+
+// Resume a computer from a checkpoint. The file is mapped rather than read,
+// so only the pages holding pending I/O and non-zero ram are ever faulted in,
+// and many computers resuming from one checkpoint share the page cache.
+inline bool load_checkpoint(IntCode &computer, const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CheckpointHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const char *base = static_cast<const char *>(mapping);
+    CheckpointHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    // Don't trust the counts until we know everything they describe is
+    // inside the file
+    size_t ram_offset, file_end;
+    if (std::memcmp(header.magic, kCheckpointMagic, sizeof(header.magic)) != 0 ||
+        !checkpoint_ram_offset(header, ram_offset) ||
+        __builtin_mul_overflow(header.ram_words, sizeof(long), &file_end) ||
+        __builtin_add_overflow(file_end, ram_offset, &file_end) ||
+        header.pc >= header.ram_words ||
+        static_cast<size_t>(info.st_size) < file_end)
+    {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+
+    size_t pages = (header.ram_words + kWordsPerPage - 1) / kWordsPerPage;
+    const uint8_t *present = reinterpret_cast<const uint8_t *>(base + sizeof(header));
+    const char *pending = reinterpret_cast<const char *>(present + pages);
+    const long *image = reinterpret_cast<const long *>(base + ram_offset);
+
+    // Start from a fresh computer, but keep how the caller set it up to run
+    int trace_threshold = computer.trace_threshold;
+    bool fast_forward = computer.fast_forward;
+    computer = IntCode();
+    computer.trace_threshold = trace_threshold;
+    computer.fast_forward = fast_forward;
+    computer.ram.assign(header.ram_words, 0);
+    computer.init_tiers();
+
+    for (size_t page = 0; page < pages; page++)
+    {
+        if (present[page])
+        {
+            size_t words = std::min(kWordsPerPage, header.ram_words - page * kWordsPerPage);
+            std::memcpy(computer.ram.data() + page * kWordsPerPage, image + page * kWordsPerPage, words * sizeof(long));
+        }
+    }
+
+    computer.pc = computer.ram.begin() + header.pc;
+    computer.relative_base = header.relative_base;
+    computer.retired = header.retired;
+    computer.hcf = header.hcf;
+    computer.halt = header.halt;
+
+    // Pending I/O follows the presence bytes, so it may not be aligned
+    for (size_t i = 0; i < header.input_count + header.output_count; i++)
+    {
+        long data;
+        std::memcpy(&data, pending + i * sizeof(long), sizeof(long));
+        if (i < header.input_count)
+        {
+            computer.input.push_back(data);
+        }
+        else
+        {
+            computer.output.push(data);
+        }
+    }
+
+    munmap(mapping, info.st_size);
+    return true;
+}
@@ -0,0 +1,685 @@
+// Intcode execution service. Keeps the day 9 program loaded and runs jobs
+// sent over a Unix domain socket on a pool of reusable computers.
+//
+//   g++ -std=c++17 -O2 -pthread -o intcoded day9/intcoded.cpp
+//
+//   intcoded serve [socket]          Run the daemon
+//   intcoded run <socket> <input>... Send one job and print its outputs
+//   intcoded stats <socket>          Print queue depth and latency percentiles
+//   intcoded load <socket> <jobs>    Send jobs and check every answer
+//
+// Every message is a fixed header followed by count 64-bit values, all in
+// host byte order since both ends are on the same machine.
+#include "day9.hpp"
+#include "intcode.hpp"
+#include "thread_pool.hpp"
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <csignal>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum RequestKind : uint32_t
+{
+    Job,
+    Stats
+};
+
+enum JobStatus : uint32_t
+{
+    Done,          // Program halted
+    NeedsInput,    // Program wanted more input than the job carried
+    OutOfBudget,
+    Fault,         // Program accessed memory outside of ram
+    TooMuchOutput, // More outputs than a reply carries, it has the first kMaxValues
+    Failed,        // The daemon couldn't run the job, e.g. out of memory
+    StatsReply     // Not a job, the answer to a Stats request
+};
+
+struct MessageHeader
+{
+    uint32_t kind;  // RequestKind for requests, JobStatus for replies
+    uint32_t count; // Number of int64 values that follow
+};
+
+// Stats replies carry these values, in this order
+enum StatsField
+{
+    QueueDepth,
+    Completed,
+    P50Micros,
+    P95Micros,
+    P99Micros,
+    StatsFields
+};
+
+static const char *kDefaultSocket{"/tmp/intcoded.sock"};
+static const uint32_t kMaxValues{1 << 20};
+static const size_t kMaxBatch{256};
+static const unsigned long kJobBudget{100000000};
+static const size_t kLatencySamples{4096};
+static const size_t kMaxQueuedBytes{1 << 24};
+static const auto kDrainGrace{std::chrono::seconds(1)};
+
+bool read_all(int fd, void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size)
+    {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+bool write_all(int fd, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size)
+    {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+std::string encode_message(uint32_t kind, const std::vector<int64_t> &values)
+{
+    MessageHeader header{kind, static_cast<uint32_t>(values.size())};
+    std::string frame(reinterpret_cast<const char *>(&header), sizeof(header));
+    frame.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(int64_t));
+    return frame;
+}
+
+bool send_message(int fd, uint32_t kind, const std::vector<int64_t> &values)
+{
+    std::string frame = encode_message(kind, values);
+    return write_all(fd, frame.data(), frame.size());
+}
+
+bool receive_message(int fd, uint32_t &kind, std::vector<int64_t> &values)
+{
+    MessageHeader header;
+    if (!read_all(fd, &header, sizeof(header)) || header.count > kMaxValues)
+    {
+        return false;
+    }
+
+    kind = header.kind;
+    values.resize(header.count);
+    return read_all(fd, values.data(), values.size() * sizeof(int64_t));
+}
+
+sockaddr_un socket_address(const std::string &path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    return address;
+}
+
+// One client. Replies, stats from its reader thread and jobs from the
+// batcher, only go on a queue here, and the client's own writer thread sends
+// them, so a client that stops reading stalls nobody else. Once it lets
+// kMaxQueuedBytes pile up it is dropped. The socket is closed when the last
+// reference lets go: the client entry, and each queued job.
+class Connection
+{
+public:
+    explicit Connection(int fd) : fd(fd)
+    {
+    };
+
+    ~Connection()
+    {
+        close(fd);
+    };
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    void reply(uint32_t kind, const std::vector<int64_t> &values)
+    {
+        enqueue(encode_message(kind, values), false);
+    };
+
+    void job_started()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_flight++;
+    };
+
+    void job_done(uint32_t status, const std::vector<int64_t> &output)
+    {
+        enqueue(encode_message(status, output), true);
+    };
+
+    // Called by the reader once the client has hung up
+    void finish_reading()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reading = false;
+        }
+        wake.notify_one();
+    };
+
+    // Wake the reader as if the client had hung up
+    void stop_reading()
+    {
+        shutdown(fd, SHUT_RD);
+    };
+
+    // Give up on the client, waking both its reader and its writer
+    void drop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            drop_locked();
+        }
+        wake.notify_one();
+    };
+
+    // Writer thread: send queued replies until the client has hung up and
+    // every job it sent has been answered, or until it's dropped
+    void write_replies()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] { return !outgoing.empty() || dropped || (!reading && !in_flight); });
+            if (dropped || outgoing.empty())
+            {
+                break;
+            }
+
+            std::string frame = std::move(outgoing.front());
+            outgoing.pop_front();
+            queued_bytes -= frame.size();
+
+            lock.unlock();
+            bool sent = write_all(fd, frame.data(), frame.size());
+            lock.lock();
+            if (!sent)
+            {
+                drop_locked();
+            }
+        }
+
+        writing = false;
+    };
+
+    const int fd;
+    std::atomic<bool> reading{true};
+    std::atomic<bool> writing{true};
+
+private:
+    void enqueue(std::string frame, bool job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight -= job;
+            if (dropped)
+            {
+                return;
+            }
+            if (queued_bytes + frame.size() > kMaxQueuedBytes)
+            {
+                drop_locked();
+            }
+            else
+            {
+                queued_bytes += frame.size();
+                outgoing.push_back(std::move(frame));
+            }
+        }
+        wake.notify_one();
+    };
+
+    void drop_locked()
+    {
+        dropped = true;
+        outgoing.clear();
+        queued_bytes = 0;
+        shutdown(fd, SHUT_RDWR);
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::string> outgoing;
+    size_t queued_bytes{0};
+    long in_flight{0}; // Jobs submitted but not yet answered
+    bool dropped{false};
+};
+
+struct Request
+{
+    std::shared_ptr<Connection> connection;
+    std::vector<int64_t> input;
+    std::chrono::steady_clock::time_point queued;
+    uint32_t status;
+    std::vector<int64_t> output;
+};
+
+class Service
+{
+public:
+    explicit Service(std::vector<long> program) : program(std::move(program))
+    {
+    };
+
+    // Queue a job from a connection, its reply is queued on the connection
+    // once its batch is done
+    void submit(std::shared_ptr<Connection> connection, std::vector<int64_t> input)
+    {
+        connection->job_started();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(Request{std::move(connection), std::move(input), std::chrono::steady_clock::now(), Done, {}});
+        }
+        wake.notify_one();
+    };
+
+    std::vector<int64_t> stats()
+    {
+        std::vector<int64_t> values(StatsFields, 0);
+        std::vector<int64_t> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            values[QueueDepth] = queue.size();
+            values[Completed] = completed;
+            sorted = latencies;
+        }
+
+        if (!sorted.empty())
+        {
+            std::sort(sorted.begin(), sorted.end());
+            values[P50Micros] = sorted[sorted.size() * 50 / 100];
+            values[P95Micros] = sorted[sorted.size() * 95 / 100];
+            values[P99Micros] = sorted[sorted.size() * 99 / 100];
+        }
+
+        return values;
+    };
+
+    // Take whatever has queued up, at most kMaxBatch requests, run them
+    // across the pool and queue the replies in the order they arrived
+    void run_batches(const std::atomic<bool> &stopping)
+    {
+        while (true)
+        {
+            std::vector<Request> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::milliseconds(100), [&] { return !queue.empty(); });
+                if (queue.empty())
+                {
+                    if (stopping)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+
+                size_t n = std::min(queue.size(), kMaxBatch);
+                batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + n));
+                queue.erase(queue.begin(), queue.begin() + n);
+            }
+
+            pool.parallel_for(batch.size(), [&](size_t i) { run_job(batch[i]); });
+
+            for (Request &request : batch)
+            {
+                request.connection->job_done(request.status, request.output);
+                record_latency(std::chrono::steady_clock::now() - request.queued);
+            }
+        }
+    };
+
+private:
+    void run_job(Request &request)
+    {
+        // Anything escaping here would take down a pool worker, and with it
+        // the daemon
+        try
+        {
+            // One computer per worker thread, reset for every job so the ram
+            // and any traces over the program's loops carry over
+            thread_local IntCode computer;
+            computer.reset(program);
+            computer.input.assign(request.input.begin(), request.input.end());
+
+            RunStatus status;
+            do
+            {
+                status = computer.run_for(kJobBudget - computer.retired);
+                while (!computer.output.empty() && request.output.size() < kMaxValues)
+                {
+                    request.output.push_back(computer.output.front());
+                    computer.output.pop();
+                }
+            } while (status == Yielded && computer.output.empty());
+
+            request.status = !computer.output.empty() ? TooMuchOutput :
+                             (status == Halted) ? Done : (status == Blocked) ? NeedsInput : OutOfBudget;
+        }
+        catch (const std::out_of_range &)
+        {
+            request.status = Fault;
+        }
+        catch (...)
+        {
+            request.status = Failed;
+        }
+    };
+
+    void record_latency(std::chrono::steady_clock::duration latency)
+    {
+        int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (latencies.size() < kLatencySamples)
+        {
+            latencies.push_back(micros);
+        }
+        else
+        {
+            latencies[completed % kLatencySamples] = micros;
+        }
+        completed++;
+    };
+
+    std::vector<long> program;
+    ThreadPool pool;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> queue;
+    std::vector<int64_t> latencies; // Most recent kLatencySamples, in microseconds
+    int64_t completed{0};
+};
+
+std::atomic<bool> stopping{false};
+
+void on_signal(int)
+{
+    stopping = true;
+}
+
+// Read requests off one connection until the client hangs up. Jobs are
+// replied to by the batcher, stats are answered straight away.
+void serve_connection(Service &service, std::shared_ptr<Connection> connection)
+{
+    uint32_t kind;
+    std::vector<int64_t> values;
+    while (receive_message(connection->fd, kind, values))
+    {
+        if (kind == Job)
+        {
+            service.submit(connection, std::move(values));
+        }
+        else
+        {
+            connection->reply(StatsReply, service.stats());
+        }
+    }
+
+    connection->finish_reading();
+}
+
+struct Client
+{
+    std::shared_ptr<Connection> connection;
+    std::thread reader;
+    std::thread writer;
+};
+
+int serve(const std::string &path)
+{
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = socket_address(path);
+    unlink(path.c_str());
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0)
+    {
+        std::cerr << "Could not listen on " << path << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    Service service(kInput);
+    std::thread batcher([&] { service.run_batches(stopping); });
+
+    std::cerr << "Listening on " << path << std::endl;
+    std::vector<Client> clients;
+    while (!stopping)
+    {
+        // Join the threads of clients that have hung up and been answered
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](Client &client) {
+            if (client.connection->reading || client.connection->writing)
+            {
+                return false;
+            }
+            client.reader.join();
+            client.writer.join();
+            return true;
+        }), clients.end());
+
+        pollfd ready{listener, POLLIN, 0};
+        if (poll(&ready, 1, 200) <= 0)
+        {
+            continue;
+        }
+
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd >= 0)
+        {
+            auto connection = std::make_shared<Connection>(fd);
+            clients.push_back(Client{connection, std::thread(serve_connection, std::ref(service), connection),
+                                     std::thread(&Connection::write_replies, connection.get())});
+        }
+    }
+
+    close(listener);
+    unlink(path.c_str());
+
+    // Readers go first so nothing is queued after the batcher drains, then
+    // writers get a moment to send what's left to clients still reading
+    for (Client &client : clients)
+    {
+        client.connection->stop_reading();
+        client.reader.join();
+    }
+    batcher.join();
+
+    auto deadline = std::chrono::steady_clock::now() + kDrainGrace;
+    while (std::chrono::steady_clock::now() < deadline &&
+           std::any_of(clients.begin(), clients.end(), [](Client &client) { return client.connection->writing.load(); }))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (Client &client : clients)
+    {
+        client.connection->drop();
+        client.writer.join();
+    }
+    clients.clear();
+
+    std::vector<int64_t> values = service.stats();
+    std::cerr << "Completed " << values[Completed] << " jobs, latency p50 " << values[P50Micros]
+              << "us p95 " << values[P95Micros] << "us p99 " << values[P99Micros] << "us" << std::endl;
+
+    return 0;
+}
+
+int connect_to(const std::string &path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = socket_address(path);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "Could not connect to " << path << std::endl;
+        std::exit(1);
+    }
+
+    return fd;
+}
+
+int run_client(const std::string &path, const std::vector<int64_t> &input)
+{
+    int fd = connect_to(path);
+
+    uint32_t status;
+    std::vector<int64_t> output;
+    if (!send_message(fd, Job, input) || !receive_message(fd, status, output))
+    {
+        std::cerr << "Lost connection" << std::endl;
+        return 1;
+    }
+
+    for (int64_t data : output)
+    {
+        std::cout << data << std::endl;
+    }
+
+    close(fd);
+    return (status == Done) ? 0 : 2;
+}
+
+int stats_client(const std::string &path)
+{
+    int fd = connect_to(path);
+
+    uint32_t status;
+    std::vector<int64_t> values;
+    if (!send_message(fd, Stats, {}) || !receive_message(fd, status, values) ||
+        status != StatsReply || values.size() < StatsFields)
+    {
+        std::cerr << "Lost connection" << std::endl;
+        return 1;
+    }
+
+    std::cout << "queue depth: " << values[QueueDepth] << std::endl
+              << "completed: " << values[Completed] << std::endl
+              << "latency p50: " << values[P50Micros] << "us" << std::endl
+              << "latency p95: " << values[P95Micros] << "us" << std::endl
+              << "latency p99: " << values[P99Micros] << "us" << std::endl;
+
+    close(fd);
+    return 0;
+}
+
+// Keep a window of jobs in flight on one connection, alternating part 1 and
+// part 2, and check every answer. A stats request goes in among the jobs now
+// and then, its replies are told apart by kind.
+int load_client(const std::string &path, long jobs)
+{
+    const long kWindow{64};
+    int fd = connect_to(path);
+
+    auto start = std::chrono::steady_clock::now();
+    long sent{0}, received{0}, wrong{0};
+    while (received < jobs)
+    {
+        while (sent < jobs && sent - received < kWindow)
+        {
+            send_message(fd, Job, {(sent % 2) ? 1 : 2});
+            sent++;
+            if (sent % 256 == 0)
+            {
+                send_message(fd, Stats, {});
+            }
+        }
+
+        uint32_t status;
+        std::vector<int64_t> output;
+        if (!receive_message(fd, status, output))
+        {
+            std::cerr << "Lost connection" << std::endl;
+            return 1;
+        }
+        if (status == StatsReply)
+        {
+            continue;
+        }
+
+        int64_t expected = (received % 2) ? 3638931938 : 86025;
+        wrong += (status != Done || output.size() != 1 || output.front() != expected);
+        received++;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << jobs << " jobs in " << elapsed.count() << "s, " << wrong << " wrong" << std::endl;
+
+    close(fd);
+    return wrong ? 2 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string command = args.empty() ? "serve" : args[0];
+    std::string path = (args.size() > 1) ? args[1] : kDefaultSocket;
+
+    if (command == "serve")
+    {
+        return serve(path);
+    }
+    else if (command == "run")
+    {
+        std::vector<int64_t> input;
+        for (size_t i = 2; i < args.size(); i++)
+        {
+            input.push_back(std::stoll(args[i]));
+        }
+        return run_client(path, input);
+    }
+    else if (command == "stats")
+    {
+        return stats_client(path);
+    }
+    else if (command == "load" && args.size() > 2)
+    {
+        return load_client(path, std::stol(args[2]));
+    }
+
+    std::cerr << "usage: intcoded serve|run|stats|load [socket] ..." << std::endl;
+    return 1;
+}
@@ -0,0 +1,149 @@
+#include "intcode.h"
+#include "intcode.hpp"
+#include "thread_pool.hpp"
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+struct intcode_program
+{
+    std::vector<long> words;
+};
+
+namespace
+{
+
+// Batches hold their own reference, so resizing never pulls the pool out
+// from under a batch that is still running
+std::mutex pool_mutex;
+std::shared_ptr<ThreadPool> pool;
+unsigned pool_threads{0};
+
+std::shared_ptr<ThreadPool> get_pool()
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool)
+    {
+        pool = pool_threads ? std::make_shared<ThreadPool>(pool_threads) : std::make_shared<ThreadPool>();
+    }
+    return pool;
+}
+
+void run_job(intcode_job &job, uint64_t budget)
+{
+    job.output_count = 0;
+    job.retired = 0;
+
+    try
+    {
+        IntCode computer(job.program->words);
+        computer.input.assign(job.input, job.input + job.input_count);
+
+        unsigned long limit = budget ? budget : std::numeric_limits<unsigned long>::max();
+        RunStatus status;
+        do
+        {
+            status = computer.run_for(limit - computer.retired);
+            while (!computer.output.empty())
+            {
+                if (job.output_count < job.output_capacity)
+                {
+                    job.output[job.output_count] = computer.output.front();
+                }
+                job.output_count++;
+                computer.output.pop();
+            }
+        } while (status == Yielded);
+
+        job.retired = computer.retired;
+        job.status = (status == Halted) ? INTCODE_HALTED : (status == Blocked) ? INTCODE_BLOCKED : INTCODE_EXHAUSTED;
+    }
+    catch (const std::out_of_range &)
+    {
+        job.status = INTCODE_FAULT;
+    }
+    catch (...)
+    {
+        job.status = INTCODE_ERROR;
+    }
+}
+
+}
+
+extern "C" {
+
+int intcode_abi_version(void)
+{
+    return INTCODE_ABI_VERSION;
+}
+
+// Nothing may propagate out of these, a C caller can't catch it
+intcode_program *intcode_register(const int64_t *words, size_t count)
+{
+    try
+    {
+        if (count > IntCode().ram.size())
+        {
+            return nullptr;
+        }
+
+        return new intcode_program{std::vector<long>(words, words + count)};
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void intcode_release(intcode_program *program)
+{
+    delete program;
+}
+
+int intcode_set_threads(unsigned threads)
+{
+    try
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (threads != pool_threads)
+        {
+            pool_threads = threads;
+            pool.reset();
+        }
+        return 0;
+    }
+    catch (...)
+    {
+        return -1;
+    }
+}
+
+size_t intcode_run_batch(intcode_job *jobs, size_t count, uint64_t budget)
+{
+    // parallel_for only throws if it couldn't start anything, so no job has
+    // been touched yet
+    try
+    {
+        get_pool()->parallel_for(count, [jobs, budget](size_t i) { run_job(jobs[i], budget); });
+    }
+    catch (...)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            jobs[i].output_count = 0;
+            jobs[i].retired = 0;
+            jobs[i].status = INTCODE_ERROR;
+        }
+        return 0;
+    }
+
+    size_t halted{0};
+    for (size_t i = 0; i < count; i++)
+    {
+        halted += (jobs[i].status == INTCODE_HALTED);
+    }
+
+    return halted;
+}
+
+}
@@ -0,0 +1,132 @@
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+// A fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+    {
+        threads = std::max(threads, 1u);
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back([this] { work(); });
+        }
+    };
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    };
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+        }
+        wake.notify_one();
+    };
+
+    // Run body(i) for every i in [0, count) across the pool and wait for all
+    // of them. Workers claim indices one at a time so uneven jobs balance out.
+    // If queueing a task throws, the tasks already queued still cover every
+    // index, so it only rethrows when none were.
+    void parallel_for(size_t count, const std::function<void(size_t)> &body)
+    {
+        std::atomic<size_t> next{0};
+        size_t n = std::min<size_t>(count, workers.size());
+        size_t remaining = n;
+        std::mutex done_mutex;
+        std::condition_variable done;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            try
+            {
+                submit([&] {
+                    for (size_t index = next++; index < count; index = next++)
+                    {
+                        body(index);
+                    }
+
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    if (--remaining == 0)
+                    {
+                        done.notify_one();
+                    }
+                });
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                remaining -= n - i;
+                if (i == 0)
+                {
+                    throw;
+                }
+                break;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.wait(lock, [&] { return remaining == 0; });
+    };
+
+    size_t size() const
+    {
+        return workers.size();
+    };
+
+    // Tasks submitted but not yet picked up by a worker
+    size_t queue_depth()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tasks.size();
+    };
+
+private:
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping{false};
+};